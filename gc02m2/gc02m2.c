@@ -14,6 +14,9 @@
 #include <linux/clk.h>
 #include <linux/device.h>
 #include <linux/delay.h>
+#include <linux/firmware.h>
+#include <linux/gc02m2.h>
+#include <linux/gcd.h>
 #include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
 #include <linux/module.h>
@@ -25,59 +28,130 @@
 #include <linux/regulator/consumer.h>
 #include <linux/sysfs.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 #include <media/media-entity.h>
+#include <media/mipi-csi2.h>
 #include <media/v4l2-async.h>
 #include <media/v4l2-ctrls.h>
+#include <media/v4l2-event.h>
 #include <media/v4l2-subdev.h>
 #include <linux/pinctrl/consumer.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
 
+#define CREATE_TRACE_POINTS
+#include "gc02m2_trace.h"
+
 #ifndef V4L2_CID_DIGITAL_GAIN
 #define V4L2_CID_DIGITAL_GAIN		V4L2_CID_GAIN
 #endif
 
 #define GC02M2_MIPI_LINK_FREQ	336000000
+/* pixel clock at GC02M2_MIPI_LINK_FREQ: 2192 x 1268 at 30 fps */
+#define GC02M2_PIXEL_CLOCK		83383680
+#define GC02M2_REG_PLL			GC02M2_REG(0, 0xf8)
 
-/* pixel rate = link frequency * 1 * lanes / BITS_PER_SAMPLE */
-#define GC02M2_PIXEL_RATE		(GC02M2_MIPI_LINK_FREQ * 2LL * 1LL / 10)
 #define GC02M2_XVCLK_FREQ		24000000
+/* optional register sequences, see gc02m2_load_firmware() */
+#define GC02M2_FW_NAME			"gc02m2_regs.bin"
+#define GC02M2_FW_MAGIC			0x4d324347	/* "GC2M" */
+#define GC02M2_FW_VERSION		1
+
+/* tunable through power/autosuspend_delay_ms */
+#define GC02M2_AUTOSUSPEND_DELAY_MS	1000
+
+/*
+ * Registers are addressed as (page, offset) pairs; the system block at
+ * offsets >= GC02M2_SYS_REG_BASE is visible from every page.
+ */
+#define GC02M2_REG(_page, _reg)	((_page) << 8 | (_reg))
+#define GC02M2_REG_PAGE(_reg)	((_reg) >> 8)
+#define GC02M2_REG_OFFSET(_reg)	((_reg) & 0xff)
 
 #define CHIP_ID					0x02f0
-#define GC02M2_REG_CHIP_ID_H	0xf0
-#define GC02M2_REG_CHIP_ID_L	0xf1
+#define GC02M2_REG_CHIP_ID_H	GC02M2_REG(0, 0xf0)
+#define GC02M2_REG_CHIP_ID_L	GC02M2_REG(0, 0xf1)
 #define SENSOR_ID(_msb, _lsb)	((_msb) << 8 | (_lsb))
 
 #define GC02M2_PAGE_SELECT		0xfe
-#define GC02M2_MODE_SELECT		0x3e
+#define GC02M2_PAGE_MASK		0x07
+#define GC02M2_NUM_PAGES		6
+#define GC02M2_PAGE_SIZE		0x100
+#define GC02M2_PAGE_UNKNOWN		-1
+#define GC02M2_NUM_REGS			(GC02M2_NUM_PAGES * GC02M2_PAGE_SIZE)
+#define GC02M2_SYS_REG_BASE		0xf0
+#define GC02M2_GAIN_FIFO_PAGE	4
+#define GC02M2_GAIN_FIFO_REG	0xc0
+#define GC02M2_BURST_MAX		64
+#define GC02M2_XFER_MAX_MSGS	8
+#define GC02M2_XFER_BUF_SIZE	32
+#define GC02M2_MODE_SELECT		GC02M2_REG(0, 0x3e)
 #define GC02M2_MODE_SW_STANDBY	0x00
 #define GC02M2_MODE_STREAMING	0x90
 
-#define GC02M2_REG_EXPOSURE_H	0x03
-#define GC02M2_REG_EXPOSURE_L	0x04
+#define GC02M2_REG_EXPOSURE_H	GC02M2_REG(0, 0x03)
+#define GC02M2_REG_EXPOSURE_L	GC02M2_REG(0, 0x04)
 #define	GC02M2_EXPOSURE_MIN		4
 #define	GC02M2_EXPOSURE_STEP	1
-#define GC02M2_VTS_MAX			0x7fff
+#define GC02M2_EXPOSURE_MARGIN	16
+/* VTS and exposure are 14 bits, the _H registers hold bits 13:8 */
+#define GC02M2_VTS_MAX			0x3fff
 
-#define GC02M2_ANALOG_GAIN_REG	0xb6
-#define GC02M2_PREGAIN_H_REG	0xb1
-#define GC02M2_PREGAIN_L_REG	0xb2
+#define GC02M2_ANALOG_GAIN_REG	GC02M2_REG(0, 0xb6)
+#define GC02M2_PREGAIN_H_REG	GC02M2_REG(0, 0xb1)
+#define GC02M2_PREGAIN_L_REG	GC02M2_REG(0, 0xb2)
 #define GC02M2_GAIN_MIN			0x40
 #define GC02M2_GAIN_MAX			0x300
 #define GC02M2_GAIN_STEP		1
 #define GC02M2_GAIN_DEFAULT		0x80
+#define GC02M2_NUM_GAINS		(GC02M2_GAIN_MAX - GC02M2_GAIN_MIN + 1)
+
+/* pregain and V4L2_CID_DIGITAL_GAIN are in units of 1/1024 */
+#define DIGITAL_GAIN_BASE		1024
+#define GC02M2_DGAIN_MIN		DIGITAL_GAIN_BASE
+#define GC02M2_DGAIN_MAX		(3 * DIGITAL_GAIN_BASE)
+#define GC02M2_DGAIN_STEP		1
+#define GC02M2_DGAIN_DEFAULT	DIGITAL_GAIN_BASE
+#define GC02M2_PREGAIN_MAX		0x0fff
 
-#define GC02M2_REG_VTS_H		0x41
-#define GC02M2_REG_VTS_L		0x42
+#define GC02M2_REG_VTS_H		GC02M2_REG(0, 0x41)
+#define GC02M2_REG_VTS_L		GC02M2_REG(0, 0x42)
+
+/*
+ * Output window on page 1: row start, column start, height, width, each
+ * a 16-bit big-endian pair. Starts are offset by GC02M2_WIN_OFFSET from
+ * the native area.
+ */
+#define GC02M2_REG_WIN_Y_H		GC02M2_REG(1, 0x91)
+#define GC02M2_WIN_OFFSET		6
+#define GC02M2_NATIVE_WIDTH		1600
+#define GC02M2_NATIVE_HEIGHT	1200
+#define GC02M2_CROP_MIN			64
 
-#define GC02M2_MIRROR_FLIP_REG	0x17
-#define SC200AI_FETCH_MIRROR(VAL, ENABLE)	(ENABLE ? VAL | 0x01 : VAL & 0xfe)
-#define SC200AI_FETCH_FLIP(VAL, ENABLE)	(ENABLE ? VAL | 0x02 : VAL & 0xfd)
+#define GC02M2_MIRROR_FLIP_REG	GC02M2_REG(0, 0x17)
+#define GC02M2_MIRROR			BIT(0)
+#define GC02M2_FLIP				BIT(1)
 
-#define GC02M2_LANES			1
+#define GC02M2_MAX_LANES		2
 #define GC02M2_BITS_PER_SAMPLE	10
 #define GC02M2_NAME			"gc02m2"
 #define REG_NULL				0xFF
 
+static bool long_exposure;
+module_param(long_exposure, bool, 0444);
+MODULE_PARM_DESC(long_exposure,
+		 "Let exposures beyond the frame stretch VTS up to its maximum");
+
+static bool status_readback;
+module_param(status_readback, bool, 0644);
+MODULE_PARM_DESC(status_readback,
+		 "Read the sensor status once per frame while streaming and queue it as an event");
+
+static bool defer_chip_id;
+module_param(defer_chip_id, bool, 0444);
+MODULE_PARM_DESC(defer_chip_id,
+		 "Do not power up the sensor at probe, check its chip ID on first use");
+
 static const char * const gc02m2_supply_names[] = {
        "dovdd",        /* Digital I/O power */
        "avdd",         /* Analog power */
@@ -98,14 +172,89 @@ struct regval {
 	u8 val;
 };
 
+/*
+ * A regval table compiled into bursts: a packed stream of records
+ * <len> <reg> <val>[len], where <reg> <val>... is sent as is as one
+ * I2C write. See gc02m2_compile_regs().
+ */
+struct gc02m2_reg_seq {
+	u8 *data;
+	unsigned int size;
+};
+
+/* Writes queued up for one multi-message i2c_transfer() */
+struct gc02m2_xfer {
+	struct i2c_msg msgs[GC02M2_XFER_MAX_MSGS];
+	u8 buf[GC02M2_XFER_BUF_SIZE];
+	unsigned int num_msgs;
+	unsigned int used;
+	int page;
+};
+
+/*
+ * Analogue gain code split into an analogue step and the pregain that
+ * makes up the rest; applied is the code the pair actually produces.
+ */
+struct gc02m2_gain {
+	u16 pregain;
+	u16 applied;
+	u8 again;
+};
+
+/*
+ * Register firmware: a header, num_seqs directory entries, then the
+ * sequences. Each sequence is already in gc02m2_reg_seq burst form,
+ * records of <len> <reg> <len values>, so it is checked once and sent
+ * as is. Whether a record fills consecutive registers or streams into
+ * one (the page 4 gain FIFO) is up to the sensor, as for the built-in
+ * tables. All fields are little endian.
+ */
+enum gc02m2_fw_seq_type {
+	GC02M2_FW_SEQ_INIT,
+	GC02M2_FW_SEQ_2LANE,
+	GC02M2_FW_SEQ_MODE,
+};
+
+struct gc02m2_fw_header {
+	__le32 magic;
+	__le16 version;
+	__le16 num_seqs;
+} __packed;
+
+struct gc02m2_fw_seq {
+	__le16 type;
+	/* GC02M2_FW_SEQ_MODE: the supported_modes[] entry to replace */
+	__le16 width;
+	__le16 height;
+	__le16 reserved;
+	/* from the start of the file */
+	__le32 offset;
+	__le32 size;
+} __packed;
+
+struct gc02m2_pll_cfg {
+	s64 link_freq;
+	u8 pll;
+};
+
+/*
+ * MIPI clock = XVCLK * 0xf8 / 4. Only the rate the init table was made
+ * for: its page 3 MIPI timing block (0x21-0x2b) is set up for 336 MHz,
+ * and other rates need those values too, which are not documented.
+ */
+static const struct gc02m2_pll_cfg gc02m2_pll_cfgs[] = {
+	{ 336000000, 0x38 },
+};
+
 struct gc02m2_mode {
 	u32 bus_fmt;
 	u32 width;
 	u32 height;
-	struct v4l2_fract max_fps;
 	u32 hts_def;
 	u32 vts_def;
 	u32 exp_def;
+	/* output window reg_list programs, within the native area */
+	struct v4l2_rect crop;
 	const struct regval *reg_list;
 };
 
@@ -121,18 +270,83 @@ struct gc02m2 {
 	struct v4l2_subdev	subdev;
 	struct media_pad	pad;
 	struct v4l2_ctrl_handler ctrl_handler;
+	/* exposure cluster (with digi_gain), see gc02m2_set_exposure_cluster() */
 	struct v4l2_ctrl	*exposure;
 	struct v4l2_ctrl	*anal_gain;
+	struct v4l2_ctrl	*vblank;
 	struct v4l2_ctrl	*digi_gain;
+	/* volatile, so kept out of the exposure cluster */
+	struct v4l2_ctrl	*anal_gain_applied;
 	struct v4l2_ctrl	*hblank;
-	struct v4l2_ctrl	*vblank;
+	/* mirror/flip cluster, one register */
+	struct v4l2_ctrl	*hflip;
+	struct v4l2_ctrl	*vflip;
+	struct v4l2_ctrl	*link_freq_ctrl;
+	struct v4l2_ctrl	*pixel_rate_ctrl;
 	struct v4l2_ctrl	*test_pattern;
 	struct mutex		mutex;
 	bool			streaming;
+	/* status_readback sampling, runs while streaming */
+	struct delayed_work	status_work;
+	u32			status_seq;
 	bool			power_on;
+	/* the init table is loaded and the cache matches the sensor */
+	bool			regs_valid;
+	/* mode whose delta the sensor holds, valid with regs_valid */
+	const struct gc02m2_mode *loaded_mode;
+	bool			chip_id_checked;
+	u16			chip_id;
+	/*
+	 * Hardware side copy of the active state, written under mutex;
+	 * readers go through the subdev active state instead.
+	 */
 	const struct gc02m2_mode *cur_mode;
+	/*
+	 * Under the active state lock: the mode the active format was picked
+	 * from, whether it changed since gc02m2_sync_active_state() last ran,
+	 * and whether a stream owns it.
+	 */
+	const struct gc02m2_mode *state_mode;
+	bool			state_dirty;
+	bool			state_busy;
+	/* published for gc02m2_g_frame_interval(), see gc02m2_publish_interval() */
+	seqlock_t		interval_lock;
+	struct v4l2_fract	interval;
+	/* set while gc02m2_s_stream is traced, see gc02m2_transfer() */
+	ktime_t			stream_start;
+	s64			first_write_ns;
+	/* active window, cur_mode->crop or a part of it */
+	struct v4l2_rect	crop;
+	struct gc02m2_reg_seq	global_seq;
+	struct gc02m2_reg_seq	lane_seq;
+	struct gc02m2_reg_seq	*mode_seqs;
 	unsigned int	lane_num;
 	unsigned int	pixel_rate;
+	u64		link_freq;
+	/* link frequencies listed by the endpoint that have a PLL setting */
+	s64		link_freq_menu[ARRAY_SIZE(gc02m2_pll_cfgs)];
+	const struct gc02m2_pll_cfg *link_cfgs[ARRAY_SIZE(gc02m2_pll_cfgs)];
+	unsigned int	nr_link_freqs;
+	/* PLL value inside global_seq, patched on a link frequency change */
+	u8		*pll_val;
+	/* 0x17 as global_seq leaves it, mirror and flip are ORed in */
+	u8		flip_base;
+	/*
+	 * Register cache. cur_page is the page the sensor has selected, or
+	 * GC02M2_PAGE_UNKNOWN after power-off or a failed transfer.
+	 * Dirty entries hold values the sensor has lost (power cycle or an
+	 * init table written over them) and are flushed by
+	 * gc02m2_regcache_sync().
+	 */
+	int			cur_page;
+	/* indexed by page and offset, the bitmaps by GC02M2_REG() */
+	u8			reg_cache[GC02M2_NUM_PAGES][GC02M2_PAGE_SIZE];
+	/* indexed by analogue gain code - GC02M2_GAIN_MIN */
+	struct gc02m2_gain	gain_lut[GC02M2_NUM_GAINS];
+	/* gain the pair last written to the sensor produces */
+	u16			gain_applied;
+	DECLARE_BITMAP(reg_valid, GC02M2_NUM_REGS);
+	DECLARE_BITMAP(reg_dirty, GC02M2_NUM_REGS);
 };
 
 /*
@@ -323,17 +537,6 @@ static const struct regval gc02m2_global_regs[] = {
 	{0x4d, 0x0c},
 	{0x44, 0x08},
 	{0x48, 0x03},
-	/*Window 1280X720*/
-	{0xfe, 0x01},
-	{0x90, 0x01},
-	{0x91, 0x00},
-	{0x92, 0x06},
-	{0x93, 0x00},
-	{0x94, 0x06},
-	{0x95, 0x02},
-	{0x96, 0xd0},
-	{0x97, 0x05},
-	{0x98, 0x00},
 	/*mipi*/
 	{0xfe, 0x03},
 	{0x01, 0x23},
@@ -354,69 +557,175 @@ static const struct regval gc02m2_global_regs[] = {
 	{REG_NULL, 0x00},
 };
 
+/*
+ * Written after gc02m2_global_regs when the endpoint has two data lanes.
+ * Unverified: no datasheet or vendor table for the GC02M2 gives this
+ * value. 0x27 only sets bit 2 on top of the one-lane 0x23 and has not
+ * been tried on a sensor; the firmware file can override it.
+ */
+static const struct regval gc02m2_2lane_regs[] = {
+	{0xfe, 0x03},
+	{0x01, 0x27},
+	{REG_NULL, 0x00},
+};
+
+/*
+ * Per-mode deltas on top of gc02m2_global_regs, the shared base. When
+ * switching modes while powered only the registers that differ from
+ * the loaded mode are sent.
+ */
+static const struct regval gc02m2_1600x1200_regs[] = {
+	/*Window 1600X1200*/
+	{0xfe, 0x01},
+	{0x90, 0x01},
+	{0x91, 0x00},
+	{0x92, 0x06},
+	{0x93, 0x00},
+	{0x94, 0x06},
+	{0x95, 0x04},
+	{0x96, 0xb0},
+	{0x97, 0x06},
+	{0x98, 0x40},
+	{REG_NULL, 0x00},
+};
+
+static const struct regval gc02m2_1280x720_regs[] = {
+	/*Window 1280X720*/
+	{0xfe, 0x01},
+	{0x90, 0x01},
+	{0x91, 0x00},
+	{0x92, 0x06},
+	{0x93, 0x00},
+	{0x94, 0x06},
+	{0x95, 0x02},
+	{0x96, 0xd0},
+	{0x97, 0x05},
+	{0x98, 0x00},
+	{REG_NULL, 0x00},
+};
+
 static const struct gc02m2_mode supported_modes[] = {
 	{
 		.width = 1280,
 		.height = 720,
-		.max_fps = {
-			.numerator = 10000,
-			.denominator = 300000,
+		.bus_fmt = MEDIA_BUS_FMT_SRGGB10_1X10,
+		.exp_def = 0x0475,
+		.hts_def = 0x0448 * 2,
+		.vts_def = 0x04f4,
+		.crop = {
+			.left = 0,
+			.top = 0,
+			.width = 1280,
+			.height = 720,
 		},
+		.reg_list = gc02m2_1280x720_regs,
+	},
+	{
+		/* full array, the CISCTL window (0x0d/0x0e) is 1212 rows */
+		.width = 1600,
+		.height = 1200,
 		.bus_fmt = MEDIA_BUS_FMT_SRGGB10_1X10,
 		.exp_def = 0x0475,
 		.hts_def = 0x0448 * 2,
 		.vts_def = 0x04f4,
-		.reg_list = gc02m2_global_regs,
+		.crop = {
+			.left = 0,
+			.top = 0,
+			.width = 1600,
+			.height = 1200,
+		},
+		.reg_list = gc02m2_1600x1200_regs,
 	},
 };
 
-static const s64 link_freq_menu_items[] = {
-	GC02M2_MIPI_LINK_FREQ
-};
+/*
+ * All bus traffic goes through here. After a failed transfer the page
+ * select may or may not have reached the sensor, so forget it.
+ */
+static int gc02m2_transfer(struct gc02m2 *gc02m2, struct i2c_msg *msgs,
+			   int num)
+{
+	bool traced = trace_gc02m2_i2c_xfer_enabled();
+	unsigned int len = 0;
+	ktime_t start = 0;
+	int i, ret;
+
+	if (traced)
+		start = ktime_get();
+
+	ret = i2c_transfer(gc02m2->client->adapter, msgs, num);
+	if (ret == num)
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
+
+	if (gc02m2->stream_start && gc02m2->first_write_ns < 0)
+		gc02m2->first_write_ns =
+			ktime_to_ns(ktime_sub(ktime_get(), gc02m2->stream_start));
+
+	for (i = 0; i < num; i++)
+		len += msgs[i].len;
+
+	if (traced) {
+		trace_gc02m2_i2c_xfer(&gc02m2->client->dev, gc02m2->cur_page,
+				      msgs[0].buf[0], num, len,
+				      ktime_to_ns(ktime_sub(ktime_get(), start)),
+				      ret);
+	}
+
+	if (ret)
+		gc02m2->cur_page = GC02M2_PAGE_UNKNOWN;
+
+	return ret;
+}
+
+static void gc02m2_track_page(struct gc02m2 *gc02m2, u8 reg, u8 val)
+{
+	if (reg == GC02M2_PAGE_SELECT)
+		gc02m2->cur_page = val & GC02M2_PAGE_MASK;
+}
 
-static int gc02m2_write_reg(struct i2c_client *client, u8 reg, u8 val)
+/* Raw write of @len registers from @reg on the currently selected page */
+static int gc02m2_i2c_write(struct gc02m2 *gc02m2, u8 reg,
+			    const u8 *vals, unsigned int len)
 {
+	struct i2c_client *client = gc02m2->client;
 	struct i2c_msg msg;
-	u8 buf[2];
+	u8 buf[GC02M2_BURST_MAX + 1];
 	int ret;
 
-	buf[0] = reg & 0xFF;
-	buf[1] = val;
+	if (len > GC02M2_BURST_MAX)
+		return -EINVAL;
+
+	buf[0] = reg;
+	memcpy(&buf[1], vals, len);
 
 	msg.addr = client->addr;
 	msg.flags = client->flags;
 	msg.buf = buf;
-	msg.len = sizeof(buf);
+	msg.len = len + 1;
 
-	ret = i2c_transfer(client->adapter, &msg, 1);
-	if (ret >= 0)
+	ret = gc02m2_transfer(gc02m2, &msg, 1);
+	if (ret == 0) {
+		gc02m2_track_page(gc02m2, reg, vals[0]);
 		return 0;
+	}
 
 	dev_err(&client->dev,
-		"gc02m2 write reg(0x%x val:0x%x) failed !\n", reg, val);
-
-	return ret;
-}
+		"gc02m2 write reg(0x%x val:0x%x len:%u) failed !\n",
+		reg, vals[0], len);
 
-static int gc02m2_write_array(struct i2c_client *client,
-			      const struct regval *regs)
-{
-	u32 i;
-	int ret = 0;
-
-	for (i = 0; ret == 0 && regs[i].addr != REG_NULL; i++) {
-		ret = gc02m2_write_reg(client, regs[i].addr, regs[i].val);
-	}
 	return ret;
 }
 
-static int gc02m2_read_reg(struct i2c_client *client, u8 reg, u8 *val)
+static int gc02m2_i2c_read(struct gc02m2 *gc02m2, u8 reg, u8 *val)
 {
+	struct i2c_client *client = gc02m2->client;
 	struct i2c_msg msg[2];
 	u8 buf[1];
 	int ret;
 
-	buf[0] = reg & 0xFF;
+	buf[0] = reg;
 
 	msg[0].addr = client->addr;
 	msg[0].flags = client->flags;
@@ -428,8 +737,8 @@ static int gc02m2_read_reg(struct i2c_client *client, u8 reg, u8 *val)
 	msg[1].buf = buf;
 	msg[1].len = 1;
 
-	ret = i2c_transfer(client->adapter, msg, 2);
-	if (ret >= 0) {
+	ret = gc02m2_transfer(gc02m2, msg, 2);
+	if (ret == 0) {
 		*val = buf[0];
 		return 0;
 	}
@@ -438,172 +747,792 @@ static int gc02m2_read_reg(struct i2c_client *client, u8 reg, u8 *val)
 	return ret;
 }
 
-static int gc02m2_get_reso_dist(const struct gc02m2_mode *mode,
-				struct v4l2_mbus_framefmt *framefmt)
+/* Switch pages only when the sensor is not already on @page */
+static int gc02m2_select_page(struct gc02m2 *gc02m2, u16 reg)
 {
-	return abs(mode->width - framefmt->width) +
-	       abs(mode->height - framefmt->height);
+	u8 page = GC02M2_REG_PAGE(reg);
+
+	if (GC02M2_REG_OFFSET(reg) >= GC02M2_SYS_REG_BASE ||
+	    gc02m2->cur_page == page)
+		return 0;
+
+	return gc02m2_i2c_write(gc02m2, GC02M2_PAGE_SELECT, &page, 1);
 }
 
-static const struct gc02m2_mode *
-gc02m2_find_best_fit(struct v4l2_subdev_format *fmt)
+/*
+ * Registers that must always go to the bus: the system block (chip ID,
+ * clock/reset and the page select itself, shared by all pages), the
+ * stream mode register, which must never be replayed by a cache sync,
+ * and the gain LUT FIFO on page 4.
+ */
+static bool gc02m2_volatile_reg(u16 reg)
+{
+	u8 page = GC02M2_REG_PAGE(reg);
+	u8 offset = GC02M2_REG_OFFSET(reg);
+
+	if (page >= GC02M2_NUM_PAGES)
+		return true;
+	if (offset >= GC02M2_SYS_REG_BASE)
+		return true;
+	if (reg == GC02M2_MODE_SELECT)
+		return true;
+	if (page == GC02M2_GAIN_FIFO_PAGE && offset == GC02M2_GAIN_FIFO_REG)
+		return true;
+
+	return false;
+}
+
+static bool gc02m2_regcache_matches(struct gc02m2 *gc02m2, u16 reg,
+				    const u8 *vals, unsigned int len)
 {
-	struct v4l2_mbus_framefmt *framefmt = &fmt->format;
-	int dist;
-	int cur_best_fit = 0;
-	int cur_best_fit_dist = -1;
 	unsigned int i;
 
-	for (i = 0; i < ARRAY_SIZE(supported_modes); i++) {
-		dist = gc02m2_get_reso_dist(&supported_modes[i], framefmt);
-		if (cur_best_fit_dist == -1 || dist < cur_best_fit_dist) {
-			cur_best_fit_dist = dist;
-			cur_best_fit = i;
-		}
+	for (i = 0; i < len; i++, reg++) {
+		if (gc02m2_volatile_reg(reg) ||
+		    !test_bit(reg, gc02m2->reg_valid) ||
+		    test_bit(reg, gc02m2->reg_dirty) ||
+		    gc02m2->reg_cache[GC02M2_REG_PAGE(reg)]
+				     [GC02M2_REG_OFFSET(reg)] != vals[i])
+			return false;
 	}
 
-	return &supported_modes[cur_best_fit];
+	return true;
 }
 
-static u32 GC02M2_AGC_Param[17][2] = {
-			{ 64  ,  0 },
-			{ 96  ,  1 },
-			{ 127 ,  2 },
-			{ 157 ,  3 },
-			{ 198 ,  4 },
-			{ 227 ,  5 },
-			{ 259 ,  6 },
-			{ 287 ,  7 },
-			{ 318 ,  8 },
-			{ 356 ,  9 },
-			{ 392 , 10 },
-			{ 420 , 11 },
-			{ 451 , 12 },
-			{ 480 , 13 },
-			{ 513 , 14 },
-			{ 646 , 15 },
-			{ 0xffff , 16 },
-};
+static void gc02m2_regcache_update(struct gc02m2 *gc02m2, u16 reg,
+				   const u8 *vals, unsigned int len)
+{
+	unsigned int i;
 
-static int gc02m2_set_fmt(struct v4l2_subdev *sd,
-			  struct v4l2_subdev_state *sd_state,
-			  struct v4l2_subdev_format *fmt)
+	for (i = 0; i < len; i++, reg++) {
+		if (gc02m2_volatile_reg(reg))
+			continue;
+		gc02m2->reg_cache[GC02M2_REG_PAGE(reg)]
+				 [GC02M2_REG_OFFSET(reg)] = vals[i];
+		__set_bit(reg, gc02m2->reg_valid);
+		__clear_bit(reg, gc02m2->reg_dirty);
+	}
+}
+
+/*
+ * Write through the cache: a write of the value the sensor already
+ * holds costs no bus traffic.
+ */
+static int gc02m2_write_reg(struct gc02m2 *gc02m2, u16 reg, u8 val)
 {
-	struct gc02m2 *gc02m2 = to_gc02m2(sd);
-	const struct gc02m2_mode *mode;
-	s64 h_blank, vblank_def;
+	int ret;
 
-	mutex_lock(&gc02m2->mutex);
+	if (gc02m2_regcache_matches(gc02m2, reg, &val, 1))
+		return 0;
 
-	mode = gc02m2_find_best_fit(fmt);
-	fmt->format.code = mode->bus_fmt;
-	fmt->format.width = mode->width;
-	fmt->format.height = mode->height;
-	fmt->format.field = V4L2_FIELD_NONE;
-	if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
-#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
-		*v4l2_subdev_get_try_format(sd, sd_state, fmt->pad) = fmt->format;
-#else
-		mutex_unlock(&gc02m2->mutex);
-		return -ENOTTY;
-#endif
-	} else {
-		gc02m2->cur_mode = mode;
-		h_blank = mode->hts_def - mode->width;
-		__v4l2_ctrl_modify_range(gc02m2->hblank, h_blank,
-					 h_blank, 1, h_blank);
-		vblank_def = mode->vts_def - mode->height;
-		__v4l2_ctrl_modify_range(gc02m2->vblank, vblank_def,
-					 GC02M2_VTS_MAX - mode->height,
-					 1, vblank_def);
-	}
+	ret = gc02m2_select_page(gc02m2, reg);
+	if (ret)
+		return ret;
 
-	mutex_unlock(&gc02m2->mutex);
+	ret = gc02m2_i2c_write(gc02m2, GC02M2_REG_OFFSET(reg), &val, 1);
+	if (ret)
+		return ret;
+
+	gc02m2_regcache_update(gc02m2, reg, &val, 1);
 
 	return 0;
 }
 
-static int gc02m2_get_fmt(struct v4l2_subdev *sd,
-			  struct v4l2_subdev_state *sd_state,
-			  struct v4l2_subdev_format *fmt)
+static void gc02m2_xfer_init(struct gc02m2 *gc02m2, struct gc02m2_xfer *xfer)
 {
-	struct gc02m2 *gc02m2 = to_gc02m2(sd);
-	const struct gc02m2_mode *mode = gc02m2->cur_mode;
+	xfer->num_msgs = 0;
+	xfer->used = 0;
+	xfer->page = gc02m2->cur_page;
+}
 
-	mutex_lock(&gc02m2->mutex);
-	if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
-#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
-		fmt->format = *v4l2_subdev_get_try_format(sd, sd_state, fmt->pad);
-#else
-		mutex_unlock(&gc02m2->mutex);
-		return -ENOTTY;
-#endif
-	} else {
-		fmt->format.width = mode->width;
-		fmt->format.height = mode->height;
-		fmt->format.code = mode->bus_fmt;
-		fmt->format.field = V4L2_FIELD_NONE;
-	}
-	mutex_unlock(&gc02m2->mutex);
+static int __gc02m2_xfer_add(struct gc02m2 *gc02m2, struct gc02m2_xfer *xfer,
+			     u8 reg, const u8 *vals, unsigned int len)
+{
+	struct i2c_msg *msg;
+
+	if (WARN_ON(xfer->num_msgs == GC02M2_XFER_MAX_MSGS ||
+		    xfer->used + len + 1 > GC02M2_XFER_BUF_SIZE))
+		return -ENOSPC;
+
+	msg = &xfer->msgs[xfer->num_msgs++];
+	msg->addr = gc02m2->client->addr;
+	msg->flags = gc02m2->client->flags;
+	msg->buf = &xfer->buf[xfer->used];
+	msg->len = len + 1;
+
+	msg->buf[0] = reg;
+	memcpy(&msg->buf[1], vals, len);
+	xfer->used += len + 1;
 
 	return 0;
 }
 
-static int gc02m2_enum_mbus_code(struct v4l2_subdev *sd,
-				 struct v4l2_subdev_state *sd_state,
-				 struct v4l2_subdev_mbus_code_enum *code)
+/*
+ * Queue a write of @len consecutive registers from @reg, preceded by a
+ * page select if needed. Writes the sensor already holds are dropped.
+ */
+static int gc02m2_xfer_add(struct gc02m2 *gc02m2, struct gc02m2_xfer *xfer,
+			   u16 reg, const u8 *vals, unsigned int len)
 {
-	struct gc02m2 *gc02m2 = to_gc02m2(sd);
-	if (code->index != 0)
-		return -EINVAL;
+	u8 page = GC02M2_REG_PAGE(reg);
+	int ret;
 
-	code->code = gc02m2->cur_mode->bus_fmt;;
+	if (gc02m2_regcache_matches(gc02m2, reg, vals, len))
+		return 0;
 
-	return 0;
+	if (GC02M2_REG_OFFSET(reg) < GC02M2_SYS_REG_BASE &&
+	    xfer->page != page) {
+		ret = __gc02m2_xfer_add(gc02m2, xfer, GC02M2_PAGE_SELECT,
+					&page, 1);
+		if (ret)
+			return ret;
+		xfer->page = page;
+	}
+
+	return __gc02m2_xfer_add(gc02m2, xfer, GC02M2_REG_OFFSET(reg),
+				 vals, len);
 }
 
-static int gc02m2_enum_frame_sizes(struct v4l2_subdev *sd,
-				   struct v4l2_subdev_state *sd_state,
-				   struct v4l2_subdev_frame_size_enum *fse)
+/*
+ * Send everything queued as a single i2c_transfer(), i.e. one bus
+ * transaction with repeated starts, and update the cache to match.
+ */
+static int gc02m2_xfer_commit(struct gc02m2 *gc02m2, struct gc02m2_xfer *xfer)
 {
-	if (fse->index >= ARRAY_SIZE(supported_modes))
-		return -EINVAL;
+	struct i2c_msg *msg;
+	int page = gc02m2->cur_page;
+	unsigned int i;
+	int ret;
 
-	if (fse->code != supported_modes[0].bus_fmt)
-		return -EINVAL;
+	if (!xfer->num_msgs)
+		return 0;
+
+	ret = gc02m2_transfer(gc02m2, xfer->msgs, xfer->num_msgs);
+	if (ret) {
+		dev_err(&gc02m2->client->dev,
+			"gc02m2 write of %u messages failed (%d)\n",
+			xfer->num_msgs, ret);
+		return ret;
+	}
 
-	fse->min_width  = supported_modes[fse->index].width;
-	fse->max_width  = supported_modes[fse->index].width;
-	fse->max_height = supported_modes[fse->index].height;
-	fse->min_height = supported_modes[fse->index].height;
+	for (i = 0; i < xfer->num_msgs; i++) {
+		msg = &xfer->msgs[i];
+		if (msg->buf[0] == GC02M2_PAGE_SELECT)
+			page = msg->buf[1] & GC02M2_PAGE_MASK;
+		else if (page != GC02M2_PAGE_UNKNOWN)
+			gc02m2_regcache_update(gc02m2,
+					       GC02M2_REG(page, msg->buf[0]),
+					       &msg->buf[1], msg->len - 1);
+	}
+	gc02m2->cur_page = xfer->page;
 
 	return 0;
 }
 
-static int gc02m2_g_frame_interval(struct v4l2_subdev *sd,
-				   struct v4l2_subdev_frame_interval *fi)
+/*
+ * Whether the write of @addr can be appended to the burst @rec. Runs of
+ * consecutive registers use the sensor's address auto-increment, and
+ * repeated writes to the gain FIFO stream into the same register. The
+ * system block and page select always stay single writes, so the vendor
+ * ordering is preserved.
+ */
+static bool gc02m2_burst_extends(const u8 *rec, int page, u8 addr)
 {
-	struct gc02m2 *gc02m2 = to_gc02m2(sd);
-	const struct gc02m2_mode *mode = gc02m2->cur_mode;
+	u8 len = rec[0], reg = rec[1];
 
-	mutex_lock(&gc02m2->mutex);
-	fi->interval = mode->max_fps;
-	mutex_unlock(&gc02m2->mutex);
+	if (len >= GC02M2_BURST_MAX || addr >= GC02M2_SYS_REG_BASE)
+		return false;
 
-	return 0;
+	if (page == GC02M2_GAIN_FIFO_PAGE &&
+	    (reg == GC02M2_GAIN_FIFO_REG || addr == GC02M2_GAIN_FIFO_REG))
+		return reg == addr;
+
+	return reg + len == addr;
 }
 
-/* Calculate the delay in us by clock rate and clock cycles */
-static inline u32 gc02m2_cal_delay(u32 cycles)
+static int gc02m2_compile_regs(struct device *dev, const struct regval *regs,
+			       struct gc02m2_reg_seq *seq)
 {
-	return DIV_ROUND_UP(cycles, GC02M2_XVCLK_FREQ / 1000 / 1000);
+	int page = GC02M2_PAGE_UNKNOWN;
+	unsigned int i, n, pos = 0;
+	u8 *rec = NULL;
+	u8 *data;
+
+	for (n = 0; regs[n].addr != REG_NULL; n++)
+		;
+
+	/* worst case: every write is a burst of its own */
+	data = devm_kmalloc(dev, n * 3, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		if (rec && gc02m2_burst_extends(rec, page, regs[i].addr)) {
+			rec[0]++;
+		} else {
+			rec = &data[pos];
+			data[pos++] = 0;
+			data[pos++] = regs[i].addr;
+			rec[0] = 1;
+		}
+		data[pos++] = regs[i].val;
+
+		if (regs[i].addr == GC02M2_PAGE_SELECT)
+			page = regs[i].val & GC02M2_PAGE_MASK;
+	}
+
+	seq->data = data;
+	seq->size = pos;
+
+	dev_dbg(dev, "compiled %u register writes into %u bytes\n", n, pos);
+
+	return 0;
 }
 
-static int __gc02m2_power_on(struct gc02m2 *gc02m2)
+/*
+ * Init tables are vendor sequences with deliberate repeated writes, so
+ * they bypass the cache entirely; callers restore the cached state on
+ * top with gc02m2_regcache_mark_dirty() and gc02m2_regcache_sync().
+ */
+static int gc02m2_write_seq(struct gc02m2 *gc02m2,
+			    const struct gc02m2_reg_seq *seq)
 {
+	struct i2c_client *client = gc02m2->client;
+	struct i2c_msg msg;
+	unsigned int pos = 0;
+	u8 len;
 	int ret;
-	u32 delay_us;
-	struct device *dev = &gc02m2->client->dev;
+
+	msg.addr = client->addr;
+	msg.flags = client->flags;
+
+	while (pos < seq->size) {
+		len = seq->data[pos];
+		msg.buf = &seq->data[pos + 1];
+		msg.len = len + 1;
+
+		ret = gc02m2_transfer(gc02m2, &msg, 1);
+		if (ret) {
+			dev_err(&client->dev,
+				"gc02m2 write burst(0x%x len:%u) failed !\n",
+				msg.buf[0], len);
+			return ret;
+		}
+
+		gc02m2_track_page(gc02m2, msg.buf[0], msg.buf[1]);
+		pos += len + 2;
+	}
+
+	return 0;
+}
+
+static int gc02m2_read_reg(struct gc02m2 *gc02m2, u16 reg, u8 *val)
+{
+	u8 page = GC02M2_REG_PAGE(reg);
+	u8 offset = GC02M2_REG_OFFSET(reg);
+	bool cached = !gc02m2_volatile_reg(reg);
+	int ret;
+
+	if (cached && test_bit(reg, gc02m2->reg_valid)) {
+		*val = gc02m2->reg_cache[page][offset];
+		return 0;
+	}
+
+	ret = gc02m2_select_page(gc02m2, reg);
+	if (ret)
+		return ret;
+
+	ret = gc02m2_i2c_read(gc02m2, offset, val);
+	if (ret)
+		return ret;
+
+	if (cached) {
+		gc02m2->reg_cache[page][offset] = *val;
+		__set_bit(reg, gc02m2->reg_valid);
+	}
+
+	return 0;
+}
+
+/* The sensor lost its registers: everything cached has to be rewritten */
+static void gc02m2_regcache_mark_dirty(struct gc02m2 *gc02m2)
+{
+	bitmap_copy(gc02m2->reg_dirty, gc02m2->reg_valid, GC02M2_NUM_REGS);
+}
+
+/*
+ * Flush dirty entries page by page, sending each run of consecutive
+ * dirty registers as a single auto-increment write.
+ */
+static int gc02m2_regcache_sync(struct gc02m2 *gc02m2)
+{
+	unsigned int idx, end, len;
+	u8 page, offset;
+	int ret;
+
+	idx = find_next_bit(gc02m2->reg_dirty, GC02M2_NUM_REGS, 0);
+	while (idx < GC02M2_NUM_REGS) {
+		page = GC02M2_REG_PAGE(idx);
+		offset = GC02M2_REG_OFFSET(idx);
+
+		end = find_next_zero_bit(gc02m2->reg_dirty,
+					 GC02M2_REG(page + 1, 0), idx);
+		len = min_t(unsigned int, end - idx, GC02M2_BURST_MAX);
+
+		ret = gc02m2_select_page(gc02m2, idx);
+		if (ret)
+			return ret;
+
+		ret = gc02m2_i2c_write(gc02m2, offset,
+				       &gc02m2->reg_cache[page][offset], len);
+		if (ret)
+			return ret;
+
+		bitmap_clear(gc02m2->reg_dirty, idx, len);
+		idx = find_next_bit(gc02m2->reg_dirty, GC02M2_NUM_REGS,
+				    idx + len);
+	}
+
+	return 0;
+}
+
+/* a frame of hts x vts pixel clocks, the same timing PIXEL_RATE reports */
+static void gc02m2_frame_interval(struct gc02m2 *gc02m2, u32 hts, u32 vts,
+				  struct v4l2_fract *interval)
+{
+	unsigned long div;
+
+	interval->numerator = hts * vts;
+	interval->denominator = gc02m2->pixel_rate;
+
+	div = gcd(interval->numerator, interval->denominator);
+	interval->numerator /= div;
+	interval->denominator /= div;
+}
+
+/* the fastest frame interval of a mode, at its default frame length */
+static void gc02m2_mode_interval(struct gc02m2 *gc02m2,
+				 const struct gc02m2_mode *mode,
+				 struct v4l2_fract *interval)
+{
+	gc02m2_frame_interval(gc02m2, mode->hts_def, mode->vts_def, interval);
+}
+
+static void gc02m2_vts_to_interval(struct gc02m2 *gc02m2, u32 vts,
+				   struct v4l2_fract *interval)
+{
+	gc02m2_frame_interval(gc02m2, gc02m2->cur_mode->hts_def, vts,
+			      interval);
+}
+
+/*
+ * The frame length the sensor runs at. With long_exposure an exposure
+ * past the frame set by VBLANK stretches it, and it shrinks back once
+ * the exposure fits again.
+ */
+static u32 gc02m2_frame_vts(struct gc02m2 *gc02m2, u32 vblank, u32 exposure)
+{
+	u32 vts = gc02m2->crop.height + vblank;
+
+	if (long_exposure)
+		vts = clamp_t(u32, exposure + GC02M2_EXPOSURE_MARGIN, vts,
+			      GC02M2_VTS_MAX);
+
+	return vts;
+}
+
+/*
+ * Called with the mutex held whenever the frame length, mode or link
+ * frequency changes, so gc02m2_g_frame_interval() never has to wait
+ * behind register I/O.
+ */
+static void gc02m2_publish_interval(struct gc02m2 *gc02m2, u32 vblank,
+				    u32 exposure)
+{
+	struct v4l2_fract interval;
+
+	gc02m2_vts_to_interval(gc02m2,
+			       gc02m2_frame_vts(gc02m2, vblank, exposure),
+			       &interval);
+
+	write_seqlock(&gc02m2->interval_lock);
+	gc02m2->interval = interval;
+	write_sequnlock(&gc02m2->interval_lock);
+}
+
+/*
+ * vts = interval * pixel rate / hts. Both products are 32 x 32 bits so
+ * cannot overflow, and the rounding works on the remainder rather than
+ * adding half the divisor to the dividend.
+ */
+static u32 gc02m2_interval_to_vts(struct gc02m2 *gc02m2,
+				  const struct v4l2_fract *interval)
+{
+	u32 vts_min = gc02m2->crop.height + gc02m2->vblank->minimum;
+	u64 dividend, divisor, rem, vts;
+
+	if (!interval->numerator)
+		return vts_min;
+	if (!interval->denominator)
+		return GC02M2_VTS_MAX;
+
+	dividend = (u64)interval->numerator * gc02m2->pixel_rate;
+	divisor = (u64)interval->denominator * gc02m2->cur_mode->hts_def;
+	vts = div64_u64_rem(dividend, divisor, &rem);
+	if (rem >= divisor - rem)
+		vts++;
+
+	return clamp_t(u64, vts, vts_min, GC02M2_VTS_MAX);
+}
+
+/*
+ * A mode is only offered if its payload at the fastest frame interval
+ * fits the CSI-2 link: link frequency * 2 (DDR) * lanes.
+ */
+static bool gc02m2_mode_fits_link(struct gc02m2 *gc02m2,
+				  const struct gc02m2_mode *mode)
+{
+	u64 link_bps = gc02m2->link_freq * 2 * gc02m2->lane_num;
+	struct v4l2_fract interval;
+	u64 mode_bps;
+
+	gc02m2_mode_interval(gc02m2, mode, &interval);
+	mode_bps = (u64)mode->width * mode->height * GC02M2_BITS_PER_SAMPLE *
+		   interval.denominator;
+	mode_bps = div_u64(mode_bps, interval.numerator);
+
+	return mode_bps <= link_bps;
+}
+
+/* index counts only the modes the link can carry */
+static const struct gc02m2_mode *
+gc02m2_get_mode(struct gc02m2 *gc02m2, unsigned int index)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(supported_modes); i++) {
+		if (!gc02m2_mode_fits_link(gc02m2, &supported_modes[i]))
+			continue;
+		if (!index--)
+			return &supported_modes[i];
+	}
+
+	return NULL;
+}
+
+static int gc02m2_get_reso_dist(const struct gc02m2_mode *mode,
+				struct v4l2_mbus_framefmt *framefmt)
+{
+	return abs(mode->width - framefmt->width) +
+	       abs(mode->height - framefmt->height);
+}
+
+static const struct gc02m2_mode *
+gc02m2_find_best_fit(struct gc02m2 *gc02m2, struct v4l2_subdev_format *fmt)
+{
+	struct v4l2_mbus_framefmt *framefmt = &fmt->format;
+	int dist;
+	int cur_best_fit = 0;
+	int cur_best_fit_dist = -1;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(supported_modes); i++) {
+		if (!gc02m2_mode_fits_link(gc02m2, &supported_modes[i]))
+			continue;
+		dist = gc02m2_get_reso_dist(&supported_modes[i], framefmt);
+		if (cur_best_fit_dist == -1 || dist < cur_best_fit_dist) {
+			cur_best_fit_dist = dist;
+			cur_best_fit = i;
+		}
+	}
+
+	return &supported_modes[cur_best_fit];
+}
+
+/* the mode reading out the most of the array that the link can carry */
+static const struct gc02m2_mode *gc02m2_max_window(struct gc02m2 *gc02m2)
+{
+	const struct gc02m2_mode *mode, *best = &supported_modes[0];
+	unsigned int i;
+
+	for (i = 0; (mode = gc02m2_get_mode(gc02m2, i)); i++)
+		if (mode->crop.width * mode->crop.height >=
+		    best->crop.width * best->crop.height)
+			best = mode;
+
+	return best;
+}
+
+/*
+ * The smallest mode window that holds the crop, the one read out for it.
+ * The windows nest, so gc02m2_max_window() holds every clamped crop.
+ */
+static const struct gc02m2_mode *
+gc02m2_mode_for_crop(struct gc02m2 *gc02m2, const struct v4l2_rect *crop)
+{
+	const struct gc02m2_mode *mode, *best = gc02m2_max_window(gc02m2);
+	const struct v4l2_rect *win;
+	unsigned int i;
+
+	for (i = 0; (mode = gc02m2_get_mode(gc02m2, i)); i++) {
+		win = &mode->crop;
+		if (crop->left < win->left || crop->top < win->top ||
+		    crop->left + crop->width > win->left + win->width ||
+		    crop->top + crop->height > win->top + win->height)
+			continue;
+		if (win->width * win->height <
+		    best->crop.width * best->crop.height)
+			best = mode;
+	}
+
+	return best;
+}
+
+static const u32 GC02M2_AGC_Param[17][2] = {
+			{ 64  ,  0 },
+			{ 96  ,  1 },
+			{ 127 ,  2 },
+			{ 157 ,  3 },
+			{ 198 ,  4 },
+			{ 227 ,  5 },
+			{ 259 ,  6 },
+			{ 287 ,  7 },
+			{ 318 ,  8 },
+			{ 356 ,  9 },
+			{ 392 , 10 },
+			{ 420 , 11 },
+			{ 451 , 12 },
+			{ 480 , 13 },
+			{ 513 , 14 },
+			{ 646 , 15 },
+			{ 0xffff , 16 },
+};
+
+/* walk GC02M2_AGC_Param once so a gain change is a table lookup */
+static void gc02m2_init_gain_lut(struct gc02m2 *gc02m2)
+{
+	struct gc02m2_gain *gain;
+	unsigned int code, i = 0;
+
+	for (code = GC02M2_GAIN_MIN; code <= GC02M2_GAIN_MAX; code++) {
+		while (code >= GC02M2_AGC_Param[i + 1][0])
+			i++;
+
+		gain = &gc02m2->gain_lut[code - GC02M2_GAIN_MIN];
+		gain->again = GC02M2_AGC_Param[i][1];
+		gain->pregain = code * DIGITAL_GAIN_BASE /
+				GC02M2_AGC_Param[i][0];
+		gain->applied = GC02M2_AGC_Param[i][0] * gain->pregain /
+				DIGITAL_GAIN_BASE;
+	}
+
+	gc02m2->gain_applied = gc02m2->gain_lut[GC02M2_GAIN_DEFAULT -
+						GC02M2_GAIN_MIN].applied;
+}
+
+static void gc02m2_gain_written(struct gc02m2 *gc02m2, u32 again)
+{
+	gc02m2->gain_applied = gc02m2->gain_lut[again -
+						GC02M2_GAIN_MIN].applied;
+}
+
+/*
+ * Bring the hardware side copy and the controls in line with the active
+ * state. Runs under the mutex with the active state unlocked, so get_fmt
+ * and friends never wait behind the VBLANK write.
+ */
+static void gc02m2_sync_active_state(struct gc02m2 *gc02m2)
+{
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	struct v4l2_subdev_state *state;
+	const struct gc02m2_mode *mode;
+	struct v4l2_rect crop;
+	s64 h_blank, vblank_def;
+	bool dirty;
+
+	lockdep_assert_held(&gc02m2->mutex);
+
+	state = v4l2_subdev_lock_and_get_active_state(sd);
+	dirty = gc02m2->state_dirty;
+	gc02m2->state_dirty = false;
+	mode = gc02m2->state_mode;
+	crop = *v4l2_subdev_get_pad_crop(sd, state, 0);
+	v4l2_subdev_unlock_state(state);
+
+	if (!dirty)
+		return;
+
+	/* the mode's delta is written by gc02m2_load_regs() */
+	WRITE_ONCE(gc02m2->cur_mode, mode);
+	gc02m2->crop = crop;
+	h_blank = mode->hts_def - mode->width;
+	__v4l2_ctrl_modify_range(gc02m2->hblank, h_blank, h_blank, 1, h_blank);
+	/* rows cropped away go to VBLANK, the frame keeps the mode's VTS */
+	vblank_def = mode->vts_def - crop.height;
+	__v4l2_ctrl_modify_range(gc02m2->vblank, vblank_def,
+				 GC02M2_VTS_MAX - crop.height, 1, vblank_def);
+	__v4l2_ctrl_s_ctrl(gc02m2->vblank, vblank_def);
+	gc02m2_publish_interval(gc02m2, gc02m2->vblank->cur.val,
+				gc02m2->exposure->cur.val);
+}
+
+/* called with the active state locked, which is dropped meanwhile */
+static void gc02m2_apply_active_state(struct gc02m2 *gc02m2,
+				      struct v4l2_subdev_state *state)
+{
+	v4l2_subdev_unlock_state(state);
+	mutex_lock(&gc02m2->mutex);
+	gc02m2_sync_active_state(gc02m2);
+	mutex_unlock(&gc02m2->mutex);
+	v4l2_subdev_lock_state(state);
+}
+
+static void gc02m2_set_state_busy(struct gc02m2 *gc02m2, bool busy)
+{
+	struct v4l2_subdev_state *state;
+
+	state = v4l2_subdev_lock_and_get_active_state(&gc02m2->subdev);
+	gc02m2->state_busy = busy;
+	v4l2_subdev_unlock_state(state);
+}
+
+static int gc02m2_set_fmt(struct v4l2_subdev *sd,
+			  struct v4l2_subdev_state *sd_state,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	const struct gc02m2_mode *mode;
+	bool active = fmt->which == V4L2_SUBDEV_FORMAT_ACTIVE;
+
+	/* callers that predate the active state pass none */
+	if (!sd_state)
+		return v4l2_subdev_call_state_active(sd, pad, set_fmt, fmt);
+
+	if (active && gc02m2->state_busy)
+		return -EBUSY;
+
+	mode = gc02m2_find_best_fit(gc02m2, fmt);
+	fmt->format.code = mode->bus_fmt;
+	fmt->format.width = mode->width;
+	fmt->format.height = mode->height;
+	fmt->format.field = V4L2_FIELD_NONE;
+
+	*v4l2_subdev_get_pad_format(sd, sd_state, fmt->pad) = fmt->format;
+	*v4l2_subdev_get_pad_crop(sd, sd_state, fmt->pad) = mode->crop;
+
+	if (active) {
+		gc02m2->state_mode = mode;
+		gc02m2->state_dirty = true;
+		gc02m2_apply_active_state(gc02m2, sd_state);
+	}
+
+	return 0;
+}
+
+static int gc02m2_get_fmt(struct v4l2_subdev *sd,
+			  struct v4l2_subdev_state *sd_state,
+			  struct v4l2_subdev_format *fmt)
+{
+	if (!sd_state)
+		return v4l2_subdev_call_state_active(sd, pad, get_fmt, fmt);
+
+	fmt->format = *v4l2_subdev_get_pad_format(sd, sd_state, fmt->pad);
+
+	return 0;
+}
+
+static int gc02m2_enum_mbus_code(struct v4l2_subdev *sd,
+				 struct v4l2_subdev_state *sd_state,
+				 struct v4l2_subdev_mbus_code_enum *code)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	if (code->index != 0)
+		return -EINVAL;
+
+	code->code = gc02m2->cur_mode->bus_fmt;;
+
+	return 0;
+}
+
+static int gc02m2_enum_frame_sizes(struct v4l2_subdev *sd,
+				   struct v4l2_subdev_state *sd_state,
+				   struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	const struct gc02m2_mode *mode;
+
+	mode = gc02m2_get_mode(gc02m2, fse->index);
+	if (!mode)
+		return -EINVAL;
+
+	if (fse->code != mode->bus_fmt)
+		return -EINVAL;
+
+	fse->min_width  = mode->width;
+	fse->max_width  = mode->width;
+	fse->max_height = mode->height;
+	fse->min_height = mode->height;
+
+	return 0;
+}
+
+static int gc02m2_g_frame_interval(struct v4l2_subdev *sd,
+				   struct v4l2_subdev_frame_interval *fi)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&gc02m2->interval_lock);
+		fi->interval = gc02m2->interval;
+	} while (read_seqretry(&gc02m2->interval_lock, seq));
+
+	return 0;
+}
+
+/*
+ * Stretch the frame to the requested interval through VBLANK. Intervals
+ * shorter than the mode allows are clamped; the achieved interval is
+ * returned.
+ */
+static int gc02m2_s_frame_interval(struct v4l2_subdev *sd,
+				   struct v4l2_subdev_frame_interval *fi)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	u32 vts;
+	int ret;
+
+	if (!fi->interval.numerator || !fi->interval.denominator)
+		return -EINVAL;
+
+	mutex_lock(&gc02m2->mutex);
+
+	vts = gc02m2_interval_to_vts(gc02m2, &fi->interval);
+	ret = __v4l2_ctrl_s_ctrl(gc02m2->vblank, vts - gc02m2->crop.height);
+	if (!ret)
+		gc02m2_vts_to_interval(gc02m2,
+				       gc02m2_frame_vts(gc02m2,
+							gc02m2->vblank->cur.val,
+							gc02m2->exposure->cur.val),
+				       &fi->interval);
+
+	mutex_unlock(&gc02m2->mutex);
+
+	return ret;
+}
+
+/* Calculate the delay in us by clock rate and clock cycles */
+static inline u32 gc02m2_cal_delay(u32 cycles)
+{
+	return DIV_ROUND_UP(cycles, GC02M2_XVCLK_FREQ / 1000 / 1000);
+}
+
+static int __gc02m2_power_on(struct gc02m2 *gc02m2)
+{
+	int ret;
+	u32 delay_us;
+	struct device *dev = &gc02m2->client->dev;
+	ktime_t start = ktime_get();
 
 	if (!IS_ERR_OR_NULL(gc02m2->pins_default)) {
 		ret = pinctrl_select_state(gc02m2->pinctrl,
@@ -619,76 +1548,427 @@ static int __gc02m2_power_on(struct gc02m2 *gc02m2)
 	ret = clk_prepare_enable(gc02m2->xvclk);
 	if (ret < 0) {
 		dev_err(dev, "Failed to enable xvclk\n");
+		goto out;
+	}
+
+	ret = regulator_bulk_enable(GC02M2_NUM_SUPPLIES, gc02m2->supplies);
+	if (ret < 0) {
+		dev_err(dev, "Failed to enable regulators\n");
+		goto disable_clk;
+	}
+
+	if (!IS_ERR(gc02m2->reset_gpio))
+		gpiod_set_value_cansleep(gc02m2->reset_gpio, 1);
+	if (!IS_ERR(gc02m2->pwdn_gpio))
+		gpiod_set_value_cansleep(gc02m2->pwdn_gpio, 0);
+
+	if (!IS_ERR(gc02m2->reset_gpio))
+		gpiod_set_value_cansleep(gc02m2->reset_gpio, 0);
+	usleep_range(500, 1000);
+
+	/* 8192 cycles prior to first SCCB transaction */
+	delay_us = gc02m2_cal_delay(8192);
+	usleep_range(delay_us, delay_us * 2);
+	ret = 0;
+	goto out;
+
+disable_clk:
+	clk_disable_unprepare(gc02m2->xvclk);
+out:
+	trace_gc02m2_power(dev, true,
+			   ktime_to_ns(ktime_sub(ktime_get(), start)), ret);
+
+	return ret;
+}
+
+static void __gc02m2_power_off(struct gc02m2 *gc02m2)
+{
+	ktime_t start = ktime_get();
+
+	if (!IS_ERR(gc02m2->pwdn_gpio))
+		gpiod_set_value_cansleep(gc02m2->pwdn_gpio, 1);
+	clk_disable_unprepare(gc02m2->xvclk);
+	if (!IS_ERR(gc02m2->reset_gpio))
+		gpiod_set_value_cansleep(gc02m2->reset_gpio, 1);
+	regulator_bulk_disable(GC02M2_NUM_SUPPLIES, gc02m2->supplies);
+	gc02m2->cur_page = GC02M2_PAGE_UNKNOWN;
+	gc02m2_regcache_mark_dirty(gc02m2);
+	gc02m2->regs_valid = false;
+	trace_gc02m2_power(&gc02m2->client->dev, false,
+			   ktime_to_ns(ktime_sub(ktime_get(), start)), 0);
+}
+
+/*
+ * Write a mode delta through the register cache, so registers already
+ * holding the value are skipped. Page selects only move the page the
+ * following records are addressed in; volatile registers, like the
+ * gain FIFO, are always sent.
+ */
+static int gc02m2_write_mode_seq(struct gc02m2 *gc02m2,
+				 const struct gc02m2_reg_seq *seq)
+{
+	unsigned int pos = 0;
+	u8 page = 0, len, reg;
+	const u8 *vals;
+	u16 addr;
+	int ret;
+
+	while (pos < seq->size) {
+		len = seq->data[pos];
+		reg = seq->data[pos + 1];
+		vals = &seq->data[pos + 2];
+		pos += len + 2;
+
+		if (reg == GC02M2_PAGE_SELECT && len == 1 &&
+		    !(vals[0] & ~GC02M2_PAGE_MASK)) {
+			page = vals[0];
+			continue;
+		}
+
+		addr = GC02M2_REG(page, reg);
+		if (gc02m2_regcache_matches(gc02m2, addr, vals, len))
+			continue;
+
+		ret = gc02m2_select_page(gc02m2, addr);
+		if (ret)
+			return ret;
+
+		ret = gc02m2_i2c_write(gc02m2, reg, vals, len);
+		if (ret)
+			return ret;
+
+		if (reg == GC02M2_PAGE_SELECT)
+			page = vals[0] & GC02M2_PAGE_MASK;
+		gc02m2_regcache_update(gc02m2, addr, vals, len);
+	}
+
+	return 0;
+}
+
+/*
+ * Cold: the base sequence, then the mode delta and the cached runtime
+ * state on top. Warm: only the delta to a different mode, if any.
+ */
+static int gc02m2_load_regs(struct gc02m2 *gc02m2)
+{
+	int ret;
+
+	if (gc02m2->regs_valid && gc02m2->loaded_mode == gc02m2->cur_mode)
+		return 0;
+
+	if (!gc02m2->regs_valid) {
+		ret = gc02m2_write_seq(gc02m2, &gc02m2->global_seq);
+		if (ret)
+			return ret;
+
+		if (gc02m2->lane_seq.size) {
+			ret = gc02m2_write_seq(gc02m2, &gc02m2->lane_seq);
+			if (ret)
+				return ret;
+		}
+
+		gc02m2_regcache_mark_dirty(gc02m2);
+		gc02m2->loaded_mode = NULL;
+	}
+
+	if (gc02m2->loaded_mode != gc02m2->cur_mode) {
+		ret = gc02m2_write_mode_seq(gc02m2,
+			&gc02m2->mode_seqs[gc02m2->cur_mode - supported_modes]);
+		if (ret)
+			return ret;
+		gc02m2->loaded_mode = gc02m2->cur_mode;
+	}
+
+	if (!gc02m2->regs_valid) {
+		ret = gc02m2_regcache_sync(gc02m2);
+		if (ret)
+			return ret;
+		gc02m2->regs_valid = true;
+	}
+
+	return 0;
+}
+
+/* the mode table leaves its default window; only a changed crop is sent */
+static int gc02m2_write_window(struct gc02m2 *gc02m2)
+{
+	const struct v4l2_rect *crop = &gc02m2->crop;
+	struct gc02m2_xfer xfer;
+	u32 top = crop->top + GC02M2_WIN_OFFSET;
+	u32 left = crop->left + GC02M2_WIN_OFFSET;
+	u8 win[8];
+	int ret;
+
+	win[0] = top >> 8;
+	win[1] = top & 0xff;
+	win[2] = left >> 8;
+	win[3] = left & 0xff;
+	win[4] = crop->height >> 8;
+	win[5] = crop->height & 0xff;
+	win[6] = crop->width >> 8;
+	win[7] = crop->width & 0xff;
+
+	gc02m2_xfer_init(gc02m2, &xfer);
+	ret = gc02m2_xfer_add(gc02m2, &xfer, GC02M2_REG_WIN_Y_H,
+			      win, sizeof(win));
+	if (ret)
 		return ret;
-	}
 
-	ret = regulator_bulk_enable(GC02M2_NUM_SUPPLIES, gc02m2->supplies);
-	if (ret < 0) {
-		dev_err(dev, "Failed to enable regulators\n");
-		goto disable_clk;
-	}
+	return gc02m2_xfer_commit(gc02m2, &xfer);
+}
 
-	if (!IS_ERR(gc02m2->reset_gpio))
-		gpiod_set_value_cansleep(gc02m2->reset_gpio, 1);
-	if (!IS_ERR(gc02m2->pwdn_gpio))
-		gpiod_set_value_cansleep(gc02m2->pwdn_gpio, 0);
+/*
+ * Frame length, exposure and gains, the exposure already fitted to the
+ * frame by gc02m2_try_ctrl(). A frame stretched for long_exposure goes
+ * out in the same transfer, so both latch on the same frame.
+ */
+static int gc02m2_xfer_add_exposure(struct gc02m2 *gc02m2,
+				    struct gc02m2_xfer *xfer, u32 vblank,
+				    u32 exposure, u32 again, u32 dgain)
+{
+	const struct gc02m2_gain *gain;
+	u32 vts, pregain;
+	u8 buf[2];
+	int ret;
 
-	if (!IS_ERR(gc02m2->reset_gpio))
-		gpiod_set_value_cansleep(gc02m2->reset_gpio, 0);
-	usleep_range(500, 1000);
+	vts = gc02m2_frame_vts(gc02m2, vblank, exposure);
+	gain = &gc02m2->gain_lut[again - GC02M2_GAIN_MIN];
+	pregain = gain->pregain * dgain / DIGITAL_GAIN_BASE;
+	pregain = min_t(u32, pregain, GC02M2_PREGAIN_MAX);
 
-	/* 8192 cycles prior to first SCCB transaction */
-	delay_us = gc02m2_cal_delay(8192);
-	usleep_range(delay_us, delay_us * 2);
-	gc02m2->power_on = true;
-	return 0;
+	buf[0] = (vts >> 8) & 0x3f;
+	buf[1] = vts & 0xff;
+	ret = gc02m2_xfer_add(gc02m2, xfer, GC02M2_REG_VTS_H, buf, 2);
+	if (ret)
+		return ret;
 
-disable_clk:
-	clk_disable_unprepare(gc02m2->xvclk);
+	/* 4 least significant bits of expsoure are fractional part */
+	buf[0] = (exposure >> 8) & 0x3f;
+	buf[1] = exposure & 0xff;
+	ret = gc02m2_xfer_add(gc02m2, xfer, GC02M2_REG_EXPOSURE_H, buf, 2);
+	if (ret)
+		return ret;
 
-	return ret;
+	buf[0] = pregain >> 8;
+	buf[1] = pregain & 0xff;
+	ret = gc02m2_xfer_add(gc02m2, xfer, GC02M2_PREGAIN_H_REG, buf, 2);
+	if (ret)
+		return ret;
+
+	return gc02m2_xfer_add(gc02m2, xfer, GC02M2_ANALOG_GAIN_REG,
+			       &gain->again, 1);
 }
 
-static void __gc02m2_power_off(struct gc02m2 *gc02m2)
+static int gc02m2_xfer_add_flip(struct gc02m2 *gc02m2,
+				struct gc02m2_xfer *xfer, bool hflip, bool vflip)
 {
-	if (!IS_ERR(gc02m2->pwdn_gpio))
-		gpiod_set_value_cansleep(gc02m2->pwdn_gpio, 1);
-	clk_disable_unprepare(gc02m2->xvclk);
-	if (!IS_ERR(gc02m2->reset_gpio))
-		gpiod_set_value_cansleep(gc02m2->reset_gpio, 1);
-	regulator_bulk_disable(GC02M2_NUM_SUPPLIES, gc02m2->supplies);
-	gc02m2->power_on = false;
+	u8 val = gc02m2->flip_base;
+
+	if (hflip)
+		val |= GC02M2_MIRROR;
+	if (vflip)
+		val |= GC02M2_FLIP;
+
+	return gc02m2_xfer_add(gc02m2, xfer, GC02M2_MIRROR_FLIP_REG, &val, 1);
 }
 
+/*
+ * Controls set while powered down are applied here, together with the
+ * stream on write, in one transfer; registers the cache shows as
+ * already holding the value are left out.
+ */
 static int __gc02m2_start_stream(struct gc02m2 *gc02m2)
 {
+	struct gc02m2_xfer xfer;
+	u8 mode = GC02M2_MODE_STREAMING;
 	int ret;
 
-	/* In case these controls are set before streaming */
-	mutex_unlock(&gc02m2->mutex);
-	ret = v4l2_ctrl_handler_setup(&gc02m2->ctrl_handler);
-	mutex_lock(&gc02m2->mutex);
+	ret = gc02m2_load_regs(gc02m2);
+	if (ret)
+		return ret;
+
+	ret = gc02m2_write_window(gc02m2);
+	if (ret)
+		return ret;
+
+	gc02m2_xfer_init(gc02m2, &xfer);
+
+	ret = gc02m2_xfer_add_exposure(gc02m2, &xfer, gc02m2->vblank->cur.val,
+				       gc02m2->exposure->cur.val,
+				       gc02m2->anal_gain->cur.val,
+				       gc02m2->digi_gain->cur.val);
+	if (ret)
+		return ret;
+
+	ret = gc02m2_xfer_add_flip(gc02m2, &xfer, gc02m2->hflip->cur.val,
+				   gc02m2->vflip->cur.val);
 	if (ret)
 		return ret;
 
-	ret = gc02m2_write_reg(gc02m2->client, GC02M2_PAGE_SELECT, 0x00);
-	ret |= gc02m2_write_reg(gc02m2->client, GC02M2_MODE_SELECT,
-				 GC02M2_MODE_STREAMING);
-	ret |= gc02m2_write_reg(gc02m2->client, GC02M2_PAGE_SELECT, 0x00);
+	ret = gc02m2_xfer_add(gc02m2, &xfer, GC02M2_MODE_SELECT, &mode, 1);
+	if (ret)
+		return ret;
+
+	ret = gc02m2_xfer_commit(gc02m2, &xfer);
+	if (!ret)
+		gc02m2_gain_written(gc02m2, gc02m2->anal_gain->cur.val);
 
 	return ret;
 }
 
 static int __gc02m2_stop_stream(struct gc02m2 *gc02m2)
 {
+	return gc02m2_write_reg(gc02m2, GC02M2_MODE_SELECT,
+				GC02M2_MODE_SW_STANDBY);
+}
+
+/* status registers, all on page 0 */
+static const struct {
+	u16 reg;
+	u8 len;
+} gc02m2_status_regs[] = {
+	{ GC02M2_REG_EXPOSURE_H,	2 },
+	{ GC02M2_MODE_SELECT,		1 },
+	{ GC02M2_REG_VTS_H,		2 },
+	{ GC02M2_PREGAIN_H_REG,		2 },
+	{ GC02M2_ANALOG_GAIN_REG,	1 },
+};
+
+/* Bypasses the cache, which holds what was written, not what latched */
+static int gc02m2_read_status(struct gc02m2 *gc02m2, struct gc02m2_status *st)
+{
+	struct i2c_client *client = gc02m2->client;
+	struct i2c_msg msgs[2 * ARRAY_SIZE(gc02m2_status_regs)];
+	u8 regs[ARRAY_SIZE(gc02m2_status_regs)];
+	u8 vals[8];
+	unsigned int i, pos = 0;
 	int ret;
 
-	ret = gc02m2_write_reg(gc02m2->client, GC02M2_PAGE_SELECT, 0x00);
-	ret |= gc02m2_write_reg(gc02m2->client, GC02M2_MODE_SELECT,
-				 GC02M2_MODE_SW_STANDBY);
-	ret |= gc02m2_write_reg(gc02m2->client, GC02M2_PAGE_SELECT, 0x00);
+	ret = gc02m2_select_page(gc02m2, GC02M2_REG_EXPOSURE_H);
+	if (ret)
+		return ret;
 
-	return ret;
+	for (i = 0; i < ARRAY_SIZE(gc02m2_status_regs); i++) {
+		regs[i] = GC02M2_REG_OFFSET(gc02m2_status_regs[i].reg);
+
+		msgs[2 * i].addr = client->addr;
+		msgs[2 * i].flags = client->flags;
+		msgs[2 * i].buf = &regs[i];
+		msgs[2 * i].len = 1;
+
+		msgs[2 * i + 1].addr = client->addr;
+		msgs[2 * i + 1].flags = client->flags | I2C_M_RD;
+		msgs[2 * i + 1].buf = &vals[pos];
+		msgs[2 * i + 1].len = gc02m2_status_regs[i].len;
+		pos += gc02m2_status_regs[i].len;
+	}
+
+	ret = gc02m2_transfer(gc02m2, msgs, ARRAY_SIZE(msgs));
+	if (ret)
+		return ret;
+
+	st->exposure = (vals[0] & 0x3f) << 8 | vals[1];
+	st->mode_select = vals[2];
+	st->vts = (vals[3] & 0x3f) << 8 | vals[4];
+	st->pregain = vals[5] << 8 | vals[6];
+	st->again = vals[7];
+
+	return 0;
+}
+
+/*
+ * There is no frame start interrupt from the sensor, so sample once per
+ * frame interval; the sequence counts samples, not sensor frames.
+ */
+static void gc02m2_status_work(struct work_struct *work)
+{
+	struct gc02m2 *gc02m2 = container_of(to_delayed_work(work),
+					     struct gc02m2, status_work);
+	struct v4l2_event ev = { .type = GC02M2_EVENT_STATUS };
+	struct gc02m2_status *st = (struct gc02m2_status *)ev.u.data;
+	struct v4l2_fract fi;
+
+	BUILD_BUG_ON(sizeof(*st) > sizeof(ev.u.data));
+
+	mutex_lock(&gc02m2->mutex);
+	if (!gc02m2->streaming)
+		goto unlock;
+
+	if (!gc02m2_read_status(gc02m2, st)) {
+		st->timestamp_ns = ktime_get_ns();
+		st->sequence = gc02m2->status_seq++;
+		v4l2_event_queue(gc02m2->subdev.devnode, &ev);
+	}
+
+	/* writers hold the mutex too */
+	fi = gc02m2->interval;
+	schedule_delayed_work(&gc02m2->status_work,
+			      usecs_to_jiffies(div_u64((u64)fi.numerator *
+						       USEC_PER_SEC,
+						       fi.denominator)));
+unlock:
+	mutex_unlock(&gc02m2->mutex);
+}
+
+static int gc02m2_check_sensor_id(struct gc02m2 *gc02m2,
+				  struct i2c_client *client)
+{
+	struct device *dev = &gc02m2->client->dev;
+	u8 pid, ver = 0x00;
+	int ret;
+	unsigned short id;
+
+	ret = gc02m2_read_reg(gc02m2, GC02M2_REG_CHIP_ID_H, &pid);
+	if (ret) {
+		dev_err(dev, "Read chip ID H register error\n");
+		return ret;
+	}
+
+	ret = gc02m2_read_reg(gc02m2, GC02M2_REG_CHIP_ID_L, &ver);
+	if (ret) {
+		dev_err(dev, "Read chip ID L register error\n");
+		return ret;
+	}
+
+	id = SENSOR_ID(pid, ver);
+	gc02m2->chip_id = id;
+	if (id != CHIP_ID) {
+		dev_err(dev, "Unexpected sensor id(%06x), ret(%d)\n", id, ret);
+		return -ENODEV;
+	}
+
+	dev_info(dev, "detected gc%04x sensor\n", id);
+	gc02m2->chip_id_checked = true;
+
+	return 0;
+}
+
+/*
+ * Runtime resume, then the chip ID check deferred from probe (see
+ * defer_chip_id). The check runs here rather than in the resume callback
+ * so a sensor that is not there yet fails this call only, without
+ * latching a runtime PM error that would fail every later resume.
+ */
+static int gc02m2_resume_and_check(struct gc02m2 *gc02m2)
+{
+	struct device *dev = &gc02m2->client->dev;
+	int ret;
+
+	ret = pm_runtime_get_sync(dev);
+	if (ret < 0) {
+		pm_runtime_put_noidle(dev);
+		return ret;
+	}
+
+	if (!gc02m2->chip_id_checked) {
+		ret = gc02m2_check_sensor_id(gc02m2, gc02m2->client);
+		if (ret) {
+			pm_runtime_put(dev);
+			return ret;
+		}
+	}
+
+	return 0;
 }
 
 static int gc02m2_s_stream(struct v4l2_subdev *sd, int on)
@@ -702,10 +1982,19 @@ static int gc02m2_s_stream(struct v4l2_subdev *sd, int on)
 	if (on == gc02m2->streaming)
 		goto unlock_and_return;
 
+	if (trace_gc02m2_s_stream_enabled()) {
+		gc02m2->stream_start = ktime_get();
+		gc02m2->first_write_ns = -1;
+	}
+
 	if (on) {
-		ret = pm_runtime_get_sync(&client->dev);
-		if (ret < 0) {
-			pm_runtime_put_noidle(&client->dev);
+		/* freeze the active format, then pick up a pending change */
+		gc02m2_set_state_busy(gc02m2, true);
+		gc02m2_sync_active_state(gc02m2);
+
+		ret = gc02m2_resume_and_check(gc02m2);
+		if (ret) {
+			gc02m2_set_state_busy(gc02m2, false);
 			goto unlock_and_return;
 		}
 
@@ -713,16 +2002,33 @@ static int gc02m2_s_stream(struct v4l2_subdev *sd, int on)
 		if (ret) {
 			v4l2_err(sd, "start stream failed while write regs\n");
 			pm_runtime_put(&client->dev);
+			gc02m2_set_state_busy(gc02m2, false);
 			goto unlock_and_return;
 		}
 	} else {
+		/* a queued sample sees !streaming under the mutex and stops */
+		cancel_delayed_work(&gc02m2->status_work);
+		/* park in software standby until autosuspend kicks in */
 		__gc02m2_stop_stream(gc02m2);
-		pm_runtime_put(&client->dev);
+		pm_runtime_mark_last_busy(&client->dev);
+		pm_runtime_put_autosuspend(&client->dev);
+		gc02m2_set_state_busy(gc02m2, false);
 	}
 
 	gc02m2->streaming = on;
+	if (on && status_readback) {
+		gc02m2->status_seq = 0;
+		schedule_delayed_work(&gc02m2->status_work, 0);
+	}
 
 unlock_and_return:
+	if (gc02m2->stream_start) {
+		trace_gc02m2_s_stream(&client->dev, on,
+				      ktime_to_ns(ktime_sub(ktime_get(),
+							    gc02m2->stream_start)),
+				      gc02m2->first_write_ns, ret);
+		gc02m2->stream_start = 0;
+	}
 	mutex_unlock(&gc02m2->mutex);
 
 	return ret;
@@ -735,19 +2041,16 @@ static int gc02m2_s_power(struct v4l2_subdev *sd, int on)
 	int ret = 0;
 
 	mutex_lock(&gc02m2->mutex);
-
 	/* If the power state is not modified - no work to do. */
 	if (gc02m2->power_on == !!on)
 		goto unlock_and_return;
 
 	if (on) {
-		ret = pm_runtime_get_sync(&client->dev);
-		if (ret < 0) {
-			pm_runtime_put_noidle(&client->dev);
+		ret = gc02m2_resume_and_check(gc02m2);
+		if (ret)
 			goto unlock_and_return;
-		}
 
-		ret = gc02m2_write_array(gc02m2->client, gc02m2->cur_mode->reg_list);
+		ret = gc02m2_load_regs(gc02m2);
 		if (ret) {
 			v4l2_err(sd, "could not set init registers\n");
 			pm_runtime_put_noidle(&client->dev);
@@ -756,7 +2059,8 @@ static int gc02m2_s_power(struct v4l2_subdev *sd, int on)
 
 		gc02m2->power_on = true;
 	} else {
-		pm_runtime_put(&client->dev);
+		pm_runtime_mark_last_busy(&client->dev);
+		pm_runtime_put_autosuspend(&client->dev);
 		gc02m2->power_on = false;
 	}
 
@@ -767,6 +2071,19 @@ unlock_and_return:
 }
 
 
+static int gc02m2_log_status(struct v4l2_subdev *sd)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+
+	if (gc02m2->chip_id_checked)
+		v4l2_info(sd, "detected gc%04x sensor\n", gc02m2->chip_id);
+	else
+		v4l2_info(sd, "sensor not detected yet, last id read %04x\n",
+			  gc02m2->chip_id);
+
+	return v4l2_ctrl_subdev_log_status(sd);
+}
+
 static int gc02m2_runtime_resume(struct device *dev)
 {
 	struct i2c_client *client = to_i2c_client(dev);
@@ -787,107 +2104,320 @@ static int gc02m2_runtime_suspend(struct device *dev)
 	return 0;
 }
 
-#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
-static int gc02m2_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
+/* both the try states and the active state start at the probe mode */
+static int gc02m2_init_cfg(struct v4l2_subdev *sd,
+			   struct v4l2_subdev_state *sd_state)
 {
-	struct gc02m2 *gc02m2 = to_gc02m2(sd);
-	struct v4l2_mbus_framefmt *try_fmt =
-				v4l2_subdev_get_try_format(sd, fh->state, 0);
+	struct v4l2_mbus_framefmt *fmt =
+				v4l2_subdev_get_pad_format(sd, sd_state, 0);
 	const struct gc02m2_mode *def_mode = &supported_modes[0];
 
-	mutex_lock(&gc02m2->mutex);
-	/* Initialize try_fmt */
-	try_fmt->width = def_mode->width;
-	try_fmt->height = def_mode->height;
-	try_fmt->code = def_mode->bus_fmt;
-	try_fmt->field = V4L2_FIELD_NONE;
-
-	mutex_unlock(&gc02m2->mutex);
-	/* No crop or compose */
+	fmt->width = def_mode->width;
+	fmt->height = def_mode->height;
+	fmt->code = def_mode->bus_fmt;
+	fmt->field = V4L2_FIELD_NONE;
+	*v4l2_subdev_get_pad_crop(sd, sd_state, 0) = def_mode->crop;
+	/* No compose */
 
 	return 0;
 }
-#endif
 
 static int gc02m2_enum_frame_interval(struct v4l2_subdev *sd,
 					struct v4l2_subdev_state *sd_state,
 					struct v4l2_subdev_frame_interval_enum *fie)
 {
-	if (fie->index >= ARRAY_SIZE(supported_modes))
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	const struct gc02m2_mode *mode;
+
+	mode = gc02m2_get_mode(gc02m2, fie->index);
+	if (!mode)
+		return -EINVAL;
+
+	fie->code = mode->bus_fmt;
+	fie->width = mode->width;
+	fie->height = mode->height;
+	gc02m2_mode_interval(gc02m2, mode, &fie->interval);
+	return 0;
+}
+
+/*
+ * One RAW10 stream on virtual channel 0. length is the payload of a
+ * frame; a line is crop width * GC02M2_BITS_PER_SAMPLE / 8 bytes.
+ */
+static int gc02m2_get_frame_desc(struct v4l2_subdev *sd, unsigned int pad,
+				 struct v4l2_mbus_frame_desc *fd)
+{
+	struct v4l2_subdev_state *state;
+	struct v4l2_mbus_framefmt fmt;
+
+	if (pad)
+		return -EINVAL;
+
+	state = v4l2_subdev_lock_and_get_active_state(sd);
+	fmt = *v4l2_subdev_get_pad_format(sd, state, pad);
+	v4l2_subdev_unlock_state(state);
+
+	memset(fd, 0, sizeof(*fd));
+	fd->type = V4L2_MBUS_FRAME_DESC_TYPE_CSI2;
+	fd->num_entries = 1;
+	fd->entry[0].flags = V4L2_MBUS_FRAME_DESC_FL_LEN_MAX;
+	fd->entry[0].stream = 0;
+	fd->entry[0].pixelcode = fmt.code;
+	fd->entry[0].length = fmt.width * fmt.height *
+			      GC02M2_BITS_PER_SAMPLE / 8;
+	fd->entry[0].bus.csi2.vc = 0;
+	fd->entry[0].bus.csi2.dt = MIPI_CSI2_DT_RAW10;
+
+	return 0;
+}
+
+static int gc02m2_get_selection(struct v4l2_subdev *sd,
+				struct v4l2_subdev_state *sd_state,
+				struct v4l2_subdev_selection *sel)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	const struct v4l2_rect *crop;
+
+	if (!sd_state)
+		return v4l2_subdev_call_state_active(sd, pad, get_selection, sel);
+
+	switch (sel->target) {
+	case V4L2_SEL_TGT_CROP:
+		sel->r = *v4l2_subdev_get_pad_crop(sd, sd_state, sel->pad);
+		return 0;
+	case V4L2_SEL_TGT_CROP_DEFAULT:
+		/* the whole window read out for this state's crop */
+		crop = v4l2_subdev_get_pad_crop(sd, sd_state, sel->pad);
+		sel->r = gc02m2_mode_for_crop(gc02m2, crop)->crop;
+		return 0;
+	case V4L2_SEL_TGT_CROP_BOUNDS:
+		sel->r = gc02m2_max_window(gc02m2)->crop;
+		return 0;
+	case V4L2_SEL_TGT_NATIVE_SIZE:
+		sel->r.left = 0;
+		sel->r.top = 0;
+		sel->r.width = GC02M2_NATIVE_WIDTH;
+		sel->r.height = GC02M2_NATIVE_HEIGHT;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * Crop anywhere inside CROP_BOUNDS. The format follows the crop, but the
+ * sensor reads out the CISCTL window of the smallest mode holding it, so
+ * VBLANK grows by the rows cropped away and the frame keeps that mode's
+ * VTS. The mode comes from the crop alone, for TRY and ACTIVE alike.
+ */
+static int gc02m2_set_selection(struct v4l2_subdev *sd,
+				struct v4l2_subdev_state *sd_state,
+				struct v4l2_subdev_selection *sel)
+{
+	struct gc02m2 *gc02m2 = to_gc02m2(sd);
+	struct v4l2_mbus_framefmt *fmt;
+	const struct gc02m2_mode *mode;
+	const struct v4l2_rect *bounds;
+	struct v4l2_rect rect;
+	bool active = sel->which == V4L2_SUBDEV_FORMAT_ACTIVE;
+
+	if (sel->target != V4L2_SEL_TGT_CROP)
 		return -EINVAL;
 
-	fie->code = supported_modes[fie->index].bus_fmt;
-	fie->width = supported_modes[fie->index].width;
-	fie->height = supported_modes[fie->index].height;
-	fie->interval = supported_modes[fie->index].max_fps;
+	if (!sd_state)
+		return v4l2_subdev_call_state_active(sd, pad, set_selection, sel);
+
+	if (active && gc02m2->state_busy)
+		return -EBUSY;
+
+	bounds = &gc02m2_max_window(gc02m2)->crop;
+
+	/* even starts and sizes keep the RGGB order */
+	rect.width = clamp_t(u32, ALIGN(sel->r.width, 2), GC02M2_CROP_MIN,
+			     bounds->width);
+	rect.height = clamp_t(u32, ALIGN(sel->r.height, 2), GC02M2_CROP_MIN,
+			      bounds->height);
+	rect.left = clamp_t(s32, ALIGN_DOWN(sel->r.left, 2), bounds->left,
+			    bounds->left + bounds->width - rect.width);
+	rect.top = clamp_t(s32, ALIGN_DOWN(sel->r.top, 2), bounds->top,
+			   bounds->top + bounds->height - rect.height);
+	mode = gc02m2_mode_for_crop(gc02m2, &rect);
+
+	*v4l2_subdev_get_pad_crop(sd, sd_state, sel->pad) = rect;
+	fmt = v4l2_subdev_get_pad_format(sd, sd_state, sel->pad);
+	fmt->code = mode->bus_fmt;
+	fmt->width = rect.width;
+	fmt->height = rect.height;
+
+	sel->r = rect;
+
+	if (active) {
+		gc02m2->state_mode = mode;
+		gc02m2->state_dirty = true;
+		gc02m2_apply_active_state(gc02m2, sd_state);
+	}
+
 	return 0;
 }
 
-static const struct dev_pm_ops gc02m2_pm_ops = {
-	SET_RUNTIME_PM_OPS(gc02m2_runtime_suspend,
-			   gc02m2_runtime_resume, NULL)
-};
+static const struct dev_pm_ops gc02m2_pm_ops = {
+	SET_RUNTIME_PM_OPS(gc02m2_runtime_suspend,
+			   gc02m2_runtime_resume, NULL)
+};
+
+static int gc02m2_subscribe_event(struct v4l2_subdev *sd,
+				  struct v4l2_fh *fh,
+				  struct v4l2_event_subscription *sub)
+{
+	if (sub->type == GC02M2_EVENT_STATUS)
+		return v4l2_event_subscribe(fh, sub, 4, NULL);
+
+	return v4l2_ctrl_subdev_subscribe_event(sd, fh, sub);
+}
+
+static const struct v4l2_subdev_core_ops gc02m2_core_ops = {
+	.s_power = gc02m2_s_power,
+	.log_status = gc02m2_log_status,
+	.subscribe_event = gc02m2_subscribe_event,
+	.unsubscribe_event = v4l2_event_subdev_unsubscribe,
+};
+
+static const struct v4l2_subdev_video_ops gc02m2_video_ops = {
+	.s_stream = gc02m2_s_stream,
+	.g_frame_interval = gc02m2_g_frame_interval,
+	.s_frame_interval = gc02m2_s_frame_interval,
+};
+
+static const struct v4l2_subdev_pad_ops gc02m2_pad_ops = {
+	.init_cfg = gc02m2_init_cfg,
+	.enum_mbus_code = gc02m2_enum_mbus_code,
+	.enum_frame_size = gc02m2_enum_frame_sizes,
+	.enum_frame_interval = gc02m2_enum_frame_interval,
+	.get_fmt = gc02m2_get_fmt,
+	.set_fmt = gc02m2_set_fmt,
+	.get_frame_desc = gc02m2_get_frame_desc,
+	.get_selection = gc02m2_get_selection,
+	.set_selection = gc02m2_set_selection,
+};
+
+static const struct v4l2_subdev_ops gc02m2_subdev_ops = {
+	.core	= &gc02m2_core_ops,
+	.video	= &gc02m2_video_ops,
+	.pad	= &gc02m2_pad_ops,
+};
+
+/*
+ * Exposure, analogue gain and VBLANK are one control cluster and are
+ * committed as a single multi-message transfer, so a frame never starts
+ * with only part of an AE update applied. The sensor has no documented
+ * group hold; the window in which a frame start can split the update
+ * is the duration of this one transfer.
+ *
+ * The exposure range cannot follow VBLANK from here, as modifying the
+ * range of a control in the cluster being set would re-enter s_ctrl.
+ * Instead the exposure is clamped to the current frame length.
+ */
+static int gc02m2_set_exposure_cluster(struct gc02m2 *gc02m2)
+{
+	struct gc02m2_xfer xfer;
+	int ret;
+
+	gc02m2_xfer_init(gc02m2, &xfer);
+	ret = gc02m2_xfer_add_exposure(gc02m2, &xfer, gc02m2->vblank->val,
+				       gc02m2->exposure->val,
+				       gc02m2->anal_gain->val,
+				       gc02m2->digi_gain->val);
+	if (ret)
+		return ret;
+
+	ret = gc02m2_xfer_commit(gc02m2, &xfer);
+	if (!ret)
+		gc02m2_gain_written(gc02m2, gc02m2->anal_gain->val);
+
+	return ret;
+}
+
+static int gc02m2_set_flip_cluster(struct gc02m2 *gc02m2)
+{
+	struct gc02m2_xfer xfer;
+	int ret;
+
+	gc02m2_xfer_init(gc02m2, &xfer);
+	ret = gc02m2_xfer_add_flip(gc02m2, &xfer, gc02m2->hflip->val,
+				   gc02m2->vflip->val);
+	if (ret)
+		return ret;
+
+	return gc02m2_xfer_commit(gc02m2, &xfer);
+}
+
+/*
+ * The PLL (0xf8) clocks both the pixel array and the MIPI block, so the
+ * pixel clock scales with the link frequency and not the lane count: with
+ * two lanes the same pixels are split across both and each lane idles for
+ * half the line. It counts blanking too, hts x vts per frame.
+ */
+static u64 gc02m2_link_pixel_rate(s64 link_freq)
+{
+	return div_u64((u64)GC02M2_PIXEL_CLOCK * link_freq,
+		       GC02M2_MIPI_LINK_FREQ);
+}
+
+static void gc02m2_apply_link_cfg(struct gc02m2 *gc02m2,
+				  const struct gc02m2_pll_cfg *cfg)
+{
+	gc02m2->link_freq = cfg->link_freq;
+	gc02m2->pixel_rate = gc02m2_link_pixel_rate(cfg->link_freq);
+	if (gc02m2->pll_val)
+		*gc02m2->pll_val = cfg->pll;
+}
 
-#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
-static const struct v4l2_subdev_internal_ops gc02m2_internal_ops = {
-	.open = gc02m2_open,
-};
-#endif
+/*
+ * The PLL is only written by the init table, so a new link frequency
+ * takes effect at the next stream on. HBLANK is in pixels and does not
+ * change; the frame intervals follow through gc02m2_mode_interval().
+ */
+static int gc02m2_set_link_freq(struct gc02m2 *gc02m2, unsigned int index)
+{
+	const struct gc02m2_pll_cfg *cfg = gc02m2->link_cfgs[index];
 
-static const struct v4l2_subdev_core_ops gc02m2_core_ops = {
-	.s_power = gc02m2_s_power,
-};
+	if (cfg->link_freq == gc02m2->link_freq)
+		return 0;
 
-static const struct v4l2_subdev_video_ops gc02m2_video_ops = {
-	.s_stream = gc02m2_s_stream,
-	.g_frame_interval = gc02m2_g_frame_interval,
-};
+	if (gc02m2->streaming)
+		return -EBUSY;
 
-static const struct v4l2_subdev_pad_ops gc02m2_pad_ops = {
-	.enum_mbus_code = gc02m2_enum_mbus_code,
-	.enum_frame_size = gc02m2_enum_frame_sizes,
-	.enum_frame_interval = gc02m2_enum_frame_interval,
-	.get_fmt = gc02m2_get_fmt,
-	.set_fmt = gc02m2_set_fmt,
-};
+	gc02m2_apply_link_cfg(gc02m2, cfg);
+	gc02m2->regs_valid = false;
+	gc02m2_publish_interval(gc02m2, gc02m2->vblank->cur.val,
+				gc02m2->exposure->cur.val);
 
-static const struct v4l2_subdev_ops gc02m2_subdev_ops = {
-	.core	= &gc02m2_core_ops,
-	.video	= &gc02m2_video_ops,
-	.pad	= &gc02m2_pad_ops,
-};
+	return __v4l2_ctrl_s_ctrl_int64(gc02m2->pixel_rate_ctrl,
+					gc02m2->pixel_rate);
+}
 
-#define DIGITAL_GAIN_BASE 1024
-static int gc02m2_set_gain_reg(struct gc02m2 *gc02m2, u32 total_gain)
+/*
+ * Without long_exposure the exposure cannot run past the frame VBLANK
+ * sets. Its range cannot follow VBLANK from within the cluster and stays
+ * at what the longest frame allows, so the exposure is fitted here, where
+ * a new VBLANK from set_fmt, s_frame_interval or userspace passes too,
+ * and the value the sensor gets is the one the control reports.
+ */
+static int gc02m2_try_ctrl(struct v4l2_ctrl *ctrl)
 {
-	struct device *dev = &gc02m2->client->dev;
-	int ret = 0, i = 0;
-	u32 dgain = 0;
+	struct gc02m2 *gc02m2 = container_of(ctrl->handler,
+					     struct gc02m2, ctrl_handler);
+	u32 vts;
 
-	dev_dbg(dev, "total_gain = 0x%04x!\n", total_gain);
-	if (total_gain < 0x40)
-		total_gain = 0x40;
+	if (ctrl->id != V4L2_CID_EXPOSURE)
+		return 0;
 
-	for (i = 15; i >= 0; i--) {
-		if (total_gain >= GC02M2_AGC_Param[i][0] &&
-			total_gain <  GC02M2_AGC_Param[i + 1][0])
-			break;
-		}
-	ret = gc02m2_write_reg(gc02m2->client,
-		GC02M2_PAGE_SELECT,	0x00);
-	ret |= gc02m2_write_reg(gc02m2->client,
-		GC02M2_ANALOG_GAIN_REG, GC02M2_AGC_Param[i][1]);
-	dgain = total_gain * DIGITAL_GAIN_BASE / GC02M2_AGC_Param[i][0];
-
-	dev_dbg(dev, "AGC_Param[%d][0] = %d dgain = 0x%04x!\n",
-		i, GC02M2_AGC_Param[i][0], dgain);
-	ret |= gc02m2_write_reg(gc02m2->client,
-		GC02M2_PREGAIN_H_REG,
-		dgain >> 8);
-	ret |= gc02m2_write_reg(gc02m2->client,
-		GC02M2_PREGAIN_L_REG,
-		dgain & 0xff);
-	return ret;
+	vts = gc02m2_frame_vts(gc02m2, gc02m2->vblank->val,
+			       gc02m2->exposure->val);
+	gc02m2->exposure->val = min_t(s32, gc02m2->exposure->val,
+				      vts - GC02M2_EXPOSURE_MARGIN);
+
+	return 0;
 }
 
 static int gc02m2_set_ctrl(struct v4l2_ctrl *ctrl)
@@ -895,64 +2425,22 @@ static int gc02m2_set_ctrl(struct v4l2_ctrl *ctrl)
 	struct gc02m2 *gc02m2 = container_of(ctrl->handler,
 					     struct gc02m2, ctrl_handler);
 	struct i2c_client *client = gc02m2->client;
-	s64 max;
 	int ret = 0;
-	u32 vts = 0;
-	u8 val = 0;
 
-	/* Propagate change of current control to all related controls */
-	switch (ctrl->id) {
-	case V4L2_CID_VBLANK:
-		/* Update max exposure while meeting expected vblanking */
-		max = gc02m2->cur_mode->height + ctrl->val - 16;
-		__v4l2_ctrl_modify_range(gc02m2->exposure,
-					 gc02m2->exposure->minimum, max,
-					 gc02m2->exposure->step,
-					 gc02m2->exposure->default_value);
-		break;
-	}
+	if (ctrl->id == V4L2_CID_LINK_FREQ)
+		return gc02m2_set_link_freq(gc02m2, ctrl->val);
 
 	if (!pm_runtime_get_if_in_use(&client->dev))
-		return 0;
+		goto publish;
 
 	switch (ctrl->id) {
 	case V4L2_CID_EXPOSURE:
-		/* 4 least significant bits of expsoure are fractional part */
-		ret = gc02m2_write_reg(gc02m2->client,
-					 GC02M2_PAGE_SELECT, 0x00);
-		ret |= gc02m2_write_reg(gc02m2->client,
-					 GC02M2_REG_EXPOSURE_H,
-					 (ctrl->val >> 8) & 0x3f);
-		ret |= gc02m2_write_reg(gc02m2->client,
-					 GC02M2_REG_EXPOSURE_L,
-					 ctrl->val & 0xff);
-
-		break;
-	case V4L2_CID_ANALOGUE_GAIN:
-		ret = gc02m2_set_gain_reg(gc02m2, ctrl->val);
-		break;
-	case V4L2_CID_VBLANK:
-		vts = ctrl->val + gc02m2->cur_mode->height;
-		ret = gc02m2_write_reg(gc02m2->client,
-					 GC02M2_PAGE_SELECT, 0x00);
-		ret |= gc02m2_write_reg(gc02m2->client, GC02M2_REG_VTS_H,
-			(vts >> 8) & 0x3f);
-		ret |= gc02m2_write_reg(gc02m2->client, GC02M2_REG_VTS_L,
-			vts & 0xff);
+		/* cluster master, also covers analogue gain and VBLANK */
+		ret = gc02m2_set_exposure_cluster(gc02m2);
 		break;
 	case V4L2_CID_HFLIP:
-		ret = gc02m2_write_reg(gc02m2->client,
-					 GC02M2_PAGE_SELECT, 0x00);
-		ret |= gc02m2_read_reg(gc02m2->client, GC02M2_MIRROR_FLIP_REG, &val);
-		ret |= gc02m2_write_reg(client, GC02M2_MIRROR_FLIP_REG,
-			SC200AI_FETCH_MIRROR(val, ctrl->val));
-		break;
-	case V4L2_CID_VFLIP:
-		ret = gc02m2_write_reg(gc02m2->client,
-					 GC02M2_PAGE_SELECT, 0x00);
-		ret |= gc02m2_read_reg(gc02m2->client, GC02M2_MIRROR_FLIP_REG, &val);
-		ret |= gc02m2_write_reg(client, GC02M2_MIRROR_FLIP_REG,
-			SC200AI_FETCH_FLIP(val, ctrl->val));
+		/* cluster master, also covers VFLIP */
+		ret = gc02m2_set_flip_cluster(gc02m2);
 		break;
 	default:
 		dev_warn(&client->dev, "%s Unhandled id:0x%x, val:0x%x\n",
@@ -960,42 +2448,263 @@ static int gc02m2_set_ctrl(struct v4l2_ctrl *ctrl)
 		break;
 	}
 
-	pm_runtime_put(&client->dev);
+	pm_runtime_mark_last_busy(&client->dev);
+	pm_runtime_put_autosuspend(&client->dev);
+
+publish:
+	/* the exposure cluster carries VBLANK */
+	if (!ret && ctrl->id == V4L2_CID_EXPOSURE)
+		gc02m2_publish_interval(gc02m2, gc02m2->vblank->val,
+					gc02m2->exposure->val);
 
 	return ret;
 }
 
+/*
+ * The analogue gain control keeps the code that was asked for; the gain
+ * the (analogue step, pregain) pair last written really applies is
+ * read back through its own control.
+ */
+static int gc02m2_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct gc02m2 *gc02m2 = container_of(ctrl->handler,
+					     struct gc02m2, ctrl_handler);
+
+	if (ctrl->id != V4L2_CID_GC02M2_ANALOGUE_GAIN_APPLIED)
+		return -EINVAL;
+
+	ctrl->val = gc02m2->gain_applied;
+
+	return 0;
+}
+
 static const struct v4l2_ctrl_ops gc02m2_ctrl_ops = {
+	.g_volatile_ctrl = gc02m2_g_volatile_ctrl,
+	.try_ctrl = gc02m2_try_ctrl,
 	.s_ctrl = gc02m2_set_ctrl,
 };
 
-static int gc02m2_check_sensor_id(struct gc02m2 *gc02m2,
-				  struct i2c_client *client)
+/* first value byte of the record starting at a system register */
+static u8 *gc02m2_seq_find(const struct gc02m2_reg_seq *seq, u16 reg)
+{
+	unsigned int pos = 0;
+
+	while (pos < seq->size) {
+		if (seq->data[pos + 1] == GC02M2_REG_OFFSET(reg))
+			return &seq->data[pos + 2];
+		pos += seq->data[pos] + 2;
+	}
+
+	return NULL;
+}
+
+/*
+ * Last value the sequence leaves in a paged register, following its
+ * page selects. Not for the gain FIFO, whose bursts hit one register.
+ */
+static const u8 *gc02m2_seq_find_paged(const struct gc02m2_reg_seq *seq,
+				       u16 addr)
+{
+	u8 page = 0, off = GC02M2_REG_OFFSET(addr), len, reg;
+	const u8 *found = NULL;
+	unsigned int pos = 0;
+
+	while (pos < seq->size) {
+		len = seq->data[pos];
+		reg = seq->data[pos + 1];
+
+		if (page == GC02M2_REG_PAGE(addr) && off >= reg &&
+		    off < reg + len)
+			found = &seq->data[pos + 2 + off - reg];
+		if (reg == GC02M2_PAGE_SELECT)
+			page = seq->data[pos + 2] & GC02M2_PAGE_MASK;
+		pos += len + 2;
+	}
+
+	return found;
+}
+
+static bool gc02m2_seq_valid(const struct gc02m2_reg_seq *seq)
+{
+	unsigned int pos = 0;
+	u8 len;
+
+	if (!seq->size)
+		return false;
+
+	while (pos < seq->size) {
+		if (seq->size - pos < 3)
+			return false;
+		len = seq->data[pos];
+		if (!len || len > GC02M2_BURST_MAX || seq->size - pos < len + 2)
+			return false;
+		pos += len + 2;
+	}
+
+	return true;
+}
+
+static struct gc02m2_reg_seq *
+gc02m2_fw_seq_target(struct gc02m2 *gc02m2, struct gc02m2_reg_seq *mode_seqs,
+		     const struct gc02m2_fw_seq *entry)
+{
+	unsigned int i;
+
+	switch (le16_to_cpu(entry->type)) {
+	case GC02M2_FW_SEQ_INIT:
+		return &gc02m2->global_seq;
+	case GC02M2_FW_SEQ_2LANE:
+		return &gc02m2->lane_seq;
+	case GC02M2_FW_SEQ_MODE:
+		for (i = 0; i < ARRAY_SIZE(supported_modes); i++)
+			if (supported_modes[i].width == le16_to_cpu(entry->width) &&
+			    supported_modes[i].height == le16_to_cpu(entry->height))
+				return &mode_seqs[i];
+		break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Replace built-in sequences with those in GC02M2_FW_NAME, if present.
+ * The file is taken as a whole or not at all; sequences it does not
+ * carry keep the compiled-in tables, so tuning can be iterated on
+ * without rebuilding the module.
+ */
+static void gc02m2_load_firmware(struct gc02m2 *gc02m2)
 {
 	struct device *dev = &gc02m2->client->dev;
-	u8 pid, ver = 0x00;
-	int ret;
-	unsigned short id;
+	struct gc02m2_reg_seq global_seq = gc02m2->global_seq;
+	struct gc02m2_reg_seq lane_seq = gc02m2->lane_seq;
+	struct gc02m2_reg_seq mode_seqs[ARRAY_SIZE(supported_modes)];
+	const struct gc02m2_fw_header *hdr;
+	const struct gc02m2_fw_seq *entry;
+	const struct firmware *fw;
+	struct gc02m2_reg_seq *seq;
+	unsigned int i, num_seqs;
+	u32 offset, size;
+	u8 *data;
+
+	if (firmware_request_nowarn(&fw, GC02M2_FW_NAME, dev))
+		return;
+
+	hdr = (const struct gc02m2_fw_header *)fw->data;
+	if (fw->size < sizeof(*hdr) ||
+	    le32_to_cpu(hdr->magic) != GC02M2_FW_MAGIC ||
+	    le16_to_cpu(hdr->version) != GC02M2_FW_VERSION) {
+		dev_warn(dev, "%s: bad header, using built-in tables\n",
+			 GC02M2_FW_NAME);
+		goto out;
+	}
 
-	ret = gc02m2_read_reg(client, GC02M2_REG_CHIP_ID_H, &pid);
-	if (ret) {
-		dev_err(dev, "Read chip ID H register error\n");
-		return ret;
+	num_seqs = le16_to_cpu(hdr->num_seqs);
+	if (fw->size < sizeof(*hdr) + num_seqs * sizeof(*entry)) {
+		dev_warn(dev, "%s: truncated, using built-in tables\n",
+			 GC02M2_FW_NAME);
+		goto out;
 	}
 
-	ret = gc02m2_read_reg(client, GC02M2_REG_CHIP_ID_L, &ver);
-	if (ret) {
-		dev_err(dev, "Read chip ID L register error\n");
-		return ret;
+	/* sequences point into this copy, the PLL value gets patched there */
+	data = devm_kmemdup(dev, fw->data, fw->size, GFP_KERNEL);
+	if (!data)
+		goto out;
+
+	memcpy(mode_seqs, gc02m2->mode_seqs, sizeof(mode_seqs));
+	entry = (const struct gc02m2_fw_seq *)(data + sizeof(*hdr));
+	for (i = 0; i < num_seqs; i++, entry++) {
+		/* lane setup for an endpoint this board does not have */
+		if (le16_to_cpu(entry->type) == GC02M2_FW_SEQ_2LANE &&
+		    gc02m2->lane_num != 2)
+			continue;
+
+		offset = le32_to_cpu(entry->offset);
+		size = le32_to_cpu(entry->size);
+		seq = gc02m2_fw_seq_target(gc02m2, mode_seqs, entry);
+		if (!seq || offset > fw->size || size > fw->size - offset) {
+			dev_warn(dev, "%s: bad sequence %u, using built-in tables\n",
+				 GC02M2_FW_NAME, i);
+			goto free_data;
+		}
+
+		seq->data = data + offset;
+		seq->size = size;
+		if (!gc02m2_seq_valid(seq)) {
+			dev_warn(dev, "%s: malformed sequence %u, using built-in tables\n",
+				 GC02M2_FW_NAME, i);
+			goto free_data;
+		}
 	}
 
-	id = SENSOR_ID(pid, ver);
-	if (id != CHIP_ID) {
-		dev_err(dev, "Unexpected sensor id(%06x), ret(%d)\n", id, ret);
+	if (!gc02m2_seq_find(&gc02m2->global_seq, GC02M2_REG_PLL)) {
+		dev_warn(dev, "%s: init sequence sets no PLL, using built-in tables\n",
+			 GC02M2_FW_NAME);
+		goto free_data;
+	}
+
+	/* mirror and flip are written on top of its 0x17 */
+	if (!gc02m2_seq_find_paged(&gc02m2->global_seq,
+				   GC02M2_MIRROR_FLIP_REG)) {
+		dev_warn(dev, "%s: init sequence sets no 0x17, using built-in tables\n",
+			 GC02M2_FW_NAME);
+		goto free_data;
+	}
+
+	memcpy(gc02m2->mode_seqs, mode_seqs, sizeof(mode_seqs));
+	dev_info(dev, "%s: %u register sequences loaded\n", GC02M2_FW_NAME,
+		 num_seqs);
+	goto out;
+
+free_data:
+	gc02m2->global_seq = global_seq;
+	gc02m2->lane_seq = lane_seq;
+	devm_kfree(dev, data);
+out:
+	release_firmware(fw);
+}
+
+static int gc02m2_compile_modes(struct gc02m2 *gc02m2)
+{
+	struct device *dev = &gc02m2->client->dev;
+	const u8 *flip;
+	unsigned int i;
+	int ret;
+
+	ret = gc02m2_compile_regs(dev, gc02m2_global_regs, &gc02m2->global_seq);
+	if (ret)
 		return ret;
+
+	if (gc02m2->lane_num == 2) {
+		ret = gc02m2_compile_regs(dev, gc02m2_2lane_regs,
+					  &gc02m2->lane_seq);
+		if (ret)
+			return ret;
 	}
 
-	dev_info(dev, "detected gc%04x sensor\n", id);
+	gc02m2->mode_seqs = devm_kcalloc(dev, ARRAY_SIZE(supported_modes),
+					 sizeof(*gc02m2->mode_seqs), GFP_KERNEL);
+	if (!gc02m2->mode_seqs)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(supported_modes); i++) {
+		ret = gc02m2_compile_regs(dev, supported_modes[i].reg_list,
+					  &gc02m2->mode_seqs[i]);
+		if (ret)
+			return ret;
+	}
+
+	gc02m2_load_firmware(gc02m2);
+
+	gc02m2->pll_val = gc02m2_seq_find(&gc02m2->global_seq, GC02M2_REG_PLL);
+	if (!gc02m2->pll_val)
+		return -EINVAL;
+	*gc02m2->pll_val = gc02m2->link_cfgs[0]->pll;
+
+	flip = gc02m2_seq_find_paged(&gc02m2->global_seq,
+				     GC02M2_MIRROR_FLIP_REG);
+	if (!flip)
+		return -EINVAL;
+	gc02m2->flip_base = *flip & ~(GC02M2_MIRROR | GC02M2_FLIP);
 
 	return 0;
 }
@@ -1012,6 +2721,69 @@ static int gc02m2_configure_regulators(struct gc02m2 *gc02m2)
 				       gc02m2->supplies);
 }
 
+static const struct gc02m2_pll_cfg *gc02m2_find_pll_cfg(s64 link_freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(gc02m2_pll_cfgs); i++)
+		if (gc02m2_pll_cfgs[i].link_freq == link_freq)
+			return &gc02m2_pll_cfgs[i];
+
+	return NULL;
+}
+
+/*
+ * Keep the endpoint's link-frequencies that have a PLL setting, in DT
+ * order; the first one is the default. Without the property the driver
+ * runs at GC02M2_MIPI_LINK_FREQ as before.
+ */
+static int gc02m2_parse_link_freqs(struct gc02m2 *gc02m2,
+				   struct fwnode_handle *fwnode)
+{
+	struct device *dev = &gc02m2->client->dev;
+	const struct gc02m2_pll_cfg *cfg;
+	/* the endpoint may list rates the table does not have */
+	u64 freqs[8];
+	unsigned int i, j;
+	int n;
+
+	n = fwnode_property_count_u64(fwnode, "link-frequencies");
+	if (n <= 0) {
+		freqs[0] = GC02M2_MIPI_LINK_FREQ;
+		n = 1;
+	} else {
+		n = min_t(int, n, ARRAY_SIZE(freqs));
+		if (fwnode_property_read_u64_array(fwnode, "link-frequencies",
+						   freqs, n))
+			return -EINVAL;
+	}
+
+	for (i = 0; i < n; i++) {
+		cfg = gc02m2_find_pll_cfg(freqs[i]);
+		if (!cfg) {
+			dev_warn(dev, "unsupported link frequency %llu\n",
+				 freqs[i]);
+			continue;
+		}
+		for (j = 0; j < gc02m2->nr_link_freqs; j++)
+			if (gc02m2->link_cfgs[j] == cfg)
+				break;
+		if (j < gc02m2->nr_link_freqs)
+			continue;
+
+		gc02m2->link_cfgs[gc02m2->nr_link_freqs] = cfg;
+		gc02m2->link_freq_menu[gc02m2->nr_link_freqs] = cfg->link_freq;
+		gc02m2->nr_link_freqs++;
+	}
+
+	if (!gc02m2->nr_link_freqs) {
+		dev_err(dev, "no supported link frequency\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static int gc02m2_parse_of(struct gc02m2 *gc02m2)
 {
 	struct device *dev = &gc02m2->client->dev;
@@ -1026,51 +2798,100 @@ static int gc02m2_parse_of(struct gc02m2 *gc02m2)
 	}
 	fwnode = of_fwnode_handle(endpoint);
 	rval = fwnode_property_read_u32_array(fwnode, "data-lanes", NULL, 0);
-	of_node_put(endpoint);
 	if (rval <= 0) {
+		of_node_put(endpoint);
 		dev_warn(dev, " Get mipi lane num failed!\n");
 		return -1;
 	}
 
 	gc02m2->lane_num = rval;
-	if (1 == gc02m2->lane_num) {
-		gc02m2->cur_mode = &supported_modes[0];
-		/* pixel rate = link frequency * 2 * lanes / BITS_PER_SAMPLE */
-		gc02m2->pixel_rate = GC02M2_MIPI_LINK_FREQ * 2U * gc02m2->lane_num / 10U;
-		dev_info(dev, "lane_num(%d)  pixel_rate(%u)\n",
-				 gc02m2->lane_num, gc02m2->pixel_rate);
-	} else {
+	if (gc02m2->lane_num < 1 || gc02m2->lane_num > GC02M2_MAX_LANES) {
+		of_node_put(endpoint);
 		dev_err(dev, "unsupported lane_num(%d)\n", gc02m2->lane_num);
 		return -1;
 	}
+	if (gc02m2->lane_num == 2)
+		dev_warn(dev, "two-lane setting is unverified, see README\n");
+
+	rval = gc02m2_parse_link_freqs(gc02m2, fwnode);
+	of_node_put(endpoint);
+	if (rval)
+		return rval;
+
+	gc02m2->cur_mode = &supported_modes[0];
+	gc02m2_apply_link_cfg(gc02m2, gc02m2->link_cfgs[0]);
+	dev_info(dev, "lane_num(%d)  pixel_rate(%u)\n",
+		 gc02m2->lane_num, gc02m2->pixel_rate);
+
 	return 0;
 }
 
+/*
+ * Frame timing registers are latched at the start of a frame, so a
+ * write that lands during frame N is expected in frame N + 2. This
+ * follows other GalaxyCore sensors and has not been measured on a
+ * GC02M2 yet. The whole exposure cluster and the mirror/flip byte
+ * each go out in one transfer and latch together. With the Media
+ * Request API the receiver applies a request's controls at frame
+ * start and can tag frame N + delay with them.
+ */
+static const u32 gc02m2_ctrl_delays[][2] = {
+	{ V4L2_CID_EXPOSURE,		2 },
+	{ V4L2_CID_ANALOGUE_GAIN,	2 },
+	{ V4L2_CID_DIGITAL_GAIN,	2 },
+	{ V4L2_CID_VBLANK,		2 },
+	{ V4L2_CID_HFLIP,		2 },
+	{ V4L2_CID_VFLIP,		2 },
+};
+
+static const struct v4l2_ctrl_config gc02m2_ctrl_delays_cfg = {
+	.id = V4L2_CID_GC02M2_CTRL_DELAYS,
+	.name = "Control Delays",
+	.type = V4L2_CTRL_TYPE_U32,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY,
+	.max = U32_MAX,
+	.step = 1,
+	.dims = { ARRAY_SIZE(gc02m2_ctrl_delays), 2 },
+};
+
+static const struct v4l2_ctrl_config gc02m2_gain_applied_cfg = {
+	.ops = &gc02m2_ctrl_ops,
+	.id = V4L2_CID_GC02M2_ANALOGUE_GAIN_APPLIED,
+	.name = "Analogue Gain Applied",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+	.min = GC02M2_GAIN_MIN,
+	.max = GC02M2_GAIN_MAX,
+	.step = GC02M2_GAIN_STEP,
+	.def = GC02M2_GAIN_DEFAULT,
+};
+
 static int gc02m2_initialize_controls(struct gc02m2 *gc02m2)
 {
 	const struct gc02m2_mode *mode;
 	struct v4l2_ctrl_handler *handler;
-	struct v4l2_ctrl *ctrl;
-	s64 exposure_max, vblank_def;
+	struct v4l2_ctrl *ctrl_delays;
+	s64 exposure_max, vblank_def, pixel_rate_max;
 	u32 h_blank;
 	int ret;
-	struct device *dev = &gc02m2->client->dev;
 
-	dev_info(dev, "Enter %s(%d) !\n", __func__, __LINE__);
 	handler = &gc02m2->ctrl_handler;
 	mode = gc02m2->cur_mode;
-	ret = v4l2_ctrl_handler_init(handler, 8);
+	ret = v4l2_ctrl_handler_init(handler, 12);
 	if (ret)
 		return ret;
 	handler->lock = &gc02m2->mutex;
 
-	ctrl = v4l2_ctrl_new_int_menu(handler, NULL, V4L2_CID_LINK_FREQ,
-				      0, 0, link_freq_menu_items);
-	if (ctrl)
-		ctrl->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+	gc02m2->link_freq_ctrl = v4l2_ctrl_new_int_menu(handler,
+				&gc02m2_ctrl_ops, V4L2_CID_LINK_FREQ,
+				gc02m2->nr_link_freqs - 1, 0,
+				gc02m2->link_freq_menu);
 
-	v4l2_ctrl_new_std(handler, NULL, V4L2_CID_PIXEL_RATE,
-			  0, GC02M2_PIXEL_RATE, 1, GC02M2_PIXEL_RATE);
+	pixel_rate_max = gc02m2_link_pixel_rate(
+		gc02m2_pll_cfgs[ARRAY_SIZE(gc02m2_pll_cfgs) - 1].link_freq);
+	gc02m2->pixel_rate_ctrl = v4l2_ctrl_new_std(handler, NULL,
+				V4L2_CID_PIXEL_RATE, 0, pixel_rate_max,
+				1, gc02m2->pixel_rate);
 
 	h_blank = mode->hts_def - mode->width;
 	gc02m2->hblank = v4l2_ctrl_new_std(handler, NULL, V4L2_CID_HBLANK,
@@ -1084,7 +2905,7 @@ static int gc02m2_initialize_controls(struct gc02m2 *gc02m2)
 				GC02M2_VTS_MAX - mode->height,
 				1, vblank_def);
 
-	exposure_max = mode->vts_def - 16;
+	exposure_max = GC02M2_VTS_MAX - GC02M2_EXPOSURE_MARGIN;
 	gc02m2->exposure = v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
 				V4L2_CID_EXPOSURE, GC02M2_EXPOSURE_MIN,
 				exposure_max, GC02M2_EXPOSURE_STEP,
@@ -1095,12 +2916,23 @@ static int gc02m2_initialize_controls(struct gc02m2 *gc02m2)
 				GC02M2_GAIN_MAX, GC02M2_GAIN_STEP,
 				GC02M2_GAIN_DEFAULT);
 
-	v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
+	gc02m2->anal_gain_applied = v4l2_ctrl_new_custom(handler,
+					&gc02m2_gain_applied_cfg, NULL);
+
+	gc02m2->digi_gain = v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
+				V4L2_CID_DIGITAL_GAIN, GC02M2_DGAIN_MIN,
+				GC02M2_DGAIN_MAX, GC02M2_DGAIN_STEP,
+				GC02M2_DGAIN_DEFAULT);
+
+	gc02m2->hflip = v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
 				V4L2_CID_HFLIP, 0, 1, 1, 0);
 
-	v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
+	gc02m2->vflip = v4l2_ctrl_new_std(handler, &gc02m2_ctrl_ops,
 				V4L2_CID_VFLIP, 0, 1, 1, 0);
 
+	ctrl_delays = v4l2_ctrl_new_custom(handler, &gc02m2_ctrl_delays_cfg,
+					   NULL);
+
 	if (handler->error) {
 		ret = handler->error;
 		dev_err(&gc02m2->client->dev,
@@ -1108,6 +2940,15 @@ static int gc02m2_initialize_controls(struct gc02m2 *gc02m2)
 		goto err_free_handler;
 	}
 
+	v4l2_ctrl_cluster(4, &gc02m2->exposure);
+	v4l2_ctrl_cluster(2, &gc02m2->hflip);
+
+	/* no ops, this only stores the table */
+	ret = v4l2_ctrl_s_ctrl_compound(ctrl_delays, V4L2_CTRL_TYPE_U32,
+					gc02m2_ctrl_delays);
+	if (ret)
+		goto err_free_handler;
+
 	gc02m2->subdev.ctrl_handler = handler;
 
 	return 0;
@@ -1118,6 +2959,69 @@ err_free_handler:
 	return ret;
 }
 
+/*
+ * The part of probe that needs no clocks, regulators or GPIOs: register
+ * sequences, controls and the subdev with its active state. It does not
+ * touch the bus either, so the KUnit suite runs it as is.
+ */
+static int gc02m2_init_subdev(struct gc02m2 *gc02m2)
+{
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	int ret;
+
+	ret = gc02m2_compile_modes(gc02m2);
+	if (ret)
+		return ret;
+	gc02m2_init_gain_lut(gc02m2);
+
+	mutex_init(&gc02m2->mutex);
+	seqlock_init(&gc02m2->interval_lock);
+	INIT_DELAYED_WORK(&gc02m2->status_work, gc02m2_status_work);
+
+	v4l2_i2c_subdev_init(sd, gc02m2->client, &gc02m2_subdev_ops);
+	ret = gc02m2_initialize_controls(gc02m2);
+	if (ret)
+		goto err_destroy_mutex;
+	gc02m2_publish_interval(gc02m2, gc02m2->vblank->cur.val,
+				gc02m2->exposure->cur.val);
+
+#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
+	sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE | V4L2_SUBDEV_FL_HAS_EVENTS;
+#endif
+	gc02m2->pad.flags = MEDIA_PAD_FL_SOURCE;
+	sd->entity.function = MEDIA_ENT_F_CAM_SENSOR;
+	ret = media_entity_pads_init(&sd->entity, 1, &gc02m2->pad);
+	if (ret < 0)
+		goto err_free_handler;
+
+	/* format and crop live in the active state, see gc02m2_init_cfg() */
+	gc02m2->state_mode = gc02m2->cur_mode;
+	ret = v4l2_subdev_init_finalize(sd);
+	if (ret)
+		goto err_clean_entity;
+
+	return 0;
+
+err_clean_entity:
+	media_entity_cleanup(&sd->entity);
+err_free_handler:
+	v4l2_ctrl_handler_free(&gc02m2->ctrl_handler);
+err_destroy_mutex:
+	mutex_destroy(&gc02m2->mutex);
+
+	return ret;
+}
+
+static void gc02m2_cleanup_subdev(struct gc02m2 *gc02m2)
+{
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+
+	v4l2_subdev_cleanup(sd);
+	media_entity_cleanup(&sd->entity);
+	v4l2_ctrl_handler_free(&gc02m2->ctrl_handler);
+	mutex_destroy(&gc02m2->mutex);
+}
+
 static int gc02m2_probe(struct i2c_client *client)
 {
 	struct device *dev = &client->dev;
@@ -1131,6 +3035,8 @@ static int gc02m2_probe(struct i2c_client *client)
 
 	gc02m2->client = client;
 	gc02m2->cur_mode = &supported_modes[0];
+	gc02m2->crop = gc02m2->cur_mode->crop;
+	gc02m2->cur_page = GC02M2_PAGE_UNKNOWN;
 
 	gc02m2->xvclk = devm_clk_get(dev, "xvclk");
 	if (IS_ERR(gc02m2->xvclk)) {
@@ -1160,52 +3066,51 @@ static int gc02m2_probe(struct i2c_client *client)
 		return ret;
 	}
 
-	mutex_init(&gc02m2->mutex);
-
-	sd = &gc02m2->subdev;
-	v4l2_i2c_subdev_init(sd, client, &gc02m2_subdev_ops);
-	ret = gc02m2_initialize_controls(gc02m2);
+	ret = gc02m2_init_subdev(gc02m2);
 	if (ret)
-		goto err_destroy_mutex;
+		return ret;
+	sd = &gc02m2->subdev;
 
-	ret = __gc02m2_power_on(gc02m2);
-	if (ret)
-		goto err_free_handler;
+	if (!defer_chip_id) {
+		ret = __gc02m2_power_on(gc02m2);
+		if (ret)
+			goto err_cleanup_subdev;
 
-	ret = gc02m2_check_sensor_id(gc02m2, client);
-	if (ret)
-		goto err_power_off;
+		ret = gc02m2_check_sensor_id(gc02m2, client);
+		if (ret)
+			goto err_power_off;
 
-#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
-	sd->internal_ops = &gc02m2_internal_ops;
-	sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
-#endif
-	gc02m2->pad.flags = MEDIA_PAD_FL_SOURCE;
-	sd->entity.function = MEDIA_ENT_F_CAM_SENSOR;
-	ret = media_entity_pads_init(&sd->entity, 1, &gc02m2->pad);
-	if (ret < 0)
-		goto err_power_off;
+		pm_runtime_set_active(dev);
+		pm_runtime_get_noresume(dev);
+	}
+	pm_runtime_enable(dev);
+	pm_runtime_set_autosuspend_delay(dev, GC02M2_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(dev);
 
 	ret = v4l2_async_register_subdev_sensor(sd);
 	if (ret) {
 		dev_err(dev, "v4l2 async register subdev failed\n");
-		goto err_clean_entity;
+		goto err_pm_disable;
 	}
 
-	pm_runtime_set_active(dev);
-	pm_runtime_enable(dev);
-	pm_runtime_idle(dev);
+	if (!defer_chip_id) {
+		pm_runtime_mark_last_busy(dev);
+		pm_runtime_put_autosuspend(dev);
+	}
 
 	return 0;
 
-err_clean_entity:
-	media_entity_cleanup(&sd->entity);
+err_pm_disable:
+	pm_runtime_dont_use_autosuspend(dev);
+	pm_runtime_disable(dev);
+	if (!defer_chip_id)
+		pm_runtime_put_noidle(dev);
+	pm_runtime_set_suspended(dev);
 err_power_off:
-	__gc02m2_power_off(gc02m2);
-err_free_handler:
-	v4l2_ctrl_handler_free(&gc02m2->ctrl_handler);
-err_destroy_mutex:
-	mutex_destroy(&gc02m2->mutex);
+	if (!defer_chip_id)
+		__gc02m2_power_off(gc02m2);
+err_cleanup_subdev:
+	gc02m2_cleanup_subdev(gc02m2);
 
 	return ret;
 }
@@ -1216,10 +3121,10 @@ static void gc02m2_remove(struct i2c_client *client)
 	struct gc02m2 *gc02m2 = to_gc02m2(sd);
 
 	v4l2_async_unregister_subdev(sd);
-	media_entity_cleanup(&sd->entity);
-	v4l2_ctrl_handler_free(&gc02m2->ctrl_handler);
-	mutex_destroy(&gc02m2->mutex);
+	cancel_delayed_work_sync(&gc02m2->status_work);
+	gc02m2_cleanup_subdev(gc02m2);
 
+	pm_runtime_dont_use_autosuspend(&client->dev);
 	pm_runtime_disable(&client->dev);
 	if (!pm_runtime_status_suspended(&client->dev))
 		__gc02m2_power_off(gc02m2);
@@ -1244,6 +3149,7 @@ static struct i2c_driver gc02m2_i2c_driver = {
 		.name = GC02M2_NAME,
 		.pm = &gc02m2_pm_ops,
 		.of_match_table = of_match_ptr(gc02m2_of_match),
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe		= &gc02m2_probe,
 	.remove		= &gc02m2_remove,
@@ -1263,5 +3169,9 @@ static void __exit sensor_mod_exit(void)
 device_initcall_sync(sensor_mod_init);
 module_exit(sensor_mod_exit);
 
+#if IS_ENABLED(CONFIG_VIDEO_GC02M2_KUNIT_TEST)
+#include "gc02m2_kunit.c"
+#endif
+
 MODULE_DESCRIPTION("GalaxyCore gc02m2 sensor driver");
 MODULE_LICENSE("GPL v2");
@@ -0,0 +1,703 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for the gc02m2 driver, included from gc02m2.c
+ *
+ * The driver runs against a fake I2C adapter that emulates the sensor's
+ * register file: six pages selected through 0xfe, the system block from
+ * 0xf0 shared by every page with the chip ID in 0xf0/0xf1, address
+ * auto-increment except into the page 4 gain FIFO, and the stream mode
+ * register 0x3e. Soft reset bits in the page select are not modelled.
+ */
+
+#include <kunit/test.h>
+
+#define GC02M2_FAKE_ADDR		0x37
+
+struct gc02m2_fake {
+	struct i2c_adapter	adap;
+	bool			adap_added;
+	struct i2c_client	*client;
+	struct gc02m2		*gc02m2;
+	/* page select bits 2:0 reach eight pages, the sensor uses six */
+	u8			regs[GC02M2_PAGE_MASK + 1][GC02M2_SYS_REG_BASE];
+	u8			sys[GC02M2_PAGE_SIZE - GC02M2_SYS_REG_BASE];
+	u8			page;
+	/* fail the next transfer with -EIO */
+	bool			fail;
+	/* bus traffic since the last gc02m2_fake_reset_counts() */
+	unsigned int		xfers;
+	unsigned int		msgs;
+	unsigned int		bytes;
+};
+
+static u8 *gc02m2_fake_reg(struct gc02m2_fake *fake, u8 reg)
+{
+	if (reg >= GC02M2_SYS_REG_BASE)
+		return &fake->sys[reg - GC02M2_SYS_REG_BASE];
+
+	return &fake->regs[fake->page][reg];
+}
+
+static u8 gc02m2_fake_read_reg(struct gc02m2_fake *fake, u16 reg)
+{
+	u8 offset = GC02M2_REG_OFFSET(reg);
+
+	if (offset >= GC02M2_SYS_REG_BASE)
+		return fake->sys[offset - GC02M2_SYS_REG_BASE];
+
+	return fake->regs[GC02M2_REG_PAGE(reg)][offset];
+}
+
+static void gc02m2_fake_write(struct gc02m2_fake *fake, u8 reg, u8 val)
+{
+	if (reg == GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_H) ||
+	    reg == GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_L))
+		return;
+
+	*gc02m2_fake_reg(fake, reg) = val;
+	if (reg == GC02M2_PAGE_SELECT)
+		fake->page = val & GC02M2_PAGE_MASK;
+}
+
+/* the address auto-increments, except in the gain FIFO, which streams */
+static u8 gc02m2_fake_next(struct gc02m2_fake *fake, u8 reg)
+{
+	if (fake->page == GC02M2_GAIN_FIFO_PAGE && reg == GC02M2_GAIN_FIFO_REG)
+		return reg;
+
+	return reg + 1;
+}
+
+static int gc02m2_fake_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			    int num)
+{
+	struct gc02m2_fake *fake = i2c_get_adapdata(adap);
+	struct i2c_msg *msg;
+	u8 reg = 0;
+	int i, j;
+
+	if (fake->fail) {
+		fake->fail = false;
+		return -EIO;
+	}
+
+	fake->xfers++;
+	for (i = 0; i < num; i++) {
+		msg = &msgs[i];
+		fake->msgs++;
+		fake->bytes += msg->len;
+
+		if (msg->addr != GC02M2_FAKE_ADDR)
+			return -ENXIO;
+
+		if (msg->flags & I2C_M_RD) {
+			for (j = 0; j < msg->len; j++) {
+				msg->buf[j] = *gc02m2_fake_reg(fake, reg);
+				reg = gc02m2_fake_next(fake, reg);
+			}
+			continue;
+		}
+
+		if (!msg->len)
+			return -EIO;
+
+		reg = msg->buf[0];
+		for (j = 1; j < msg->len; j++) {
+			gc02m2_fake_write(fake, reg, msg->buf[j]);
+			reg = gc02m2_fake_next(fake, reg);
+		}
+	}
+
+	return num;
+}
+
+static u32 gc02m2_fake_functionality(struct i2c_adapter *adap)
+{
+	return I2C_FUNC_I2C;
+}
+
+static const struct i2c_algorithm gc02m2_fake_algo = {
+	.master_xfer	= gc02m2_fake_xfer,
+	.functionality	= gc02m2_fake_functionality,
+};
+
+static void gc02m2_fake_reset_counts(struct gc02m2_fake *fake)
+{
+	fake->xfers = 0;
+	fake->msgs = 0;
+	fake->bytes = 0;
+}
+
+/* every register the driver has cached must hold that value in the fake */
+static void gc02m2_expect_cache_matches(struct kunit *test,
+					struct gc02m2_fake *fake)
+{
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	unsigned int reg;
+
+	for_each_set_bit(reg, gc02m2->reg_valid, GC02M2_NUM_REGS) {
+		if (test_bit(reg, gc02m2->reg_dirty))
+			continue;
+
+		KUNIT_EXPECT_EQ_MSG(test, gc02m2_fake_read_reg(fake, reg),
+				    gc02m2->reg_cache[GC02M2_REG_PAGE(reg)]
+						     [GC02M2_REG_OFFSET(reg)],
+				    "register %u:0x%02x", GC02M2_REG_PAGE(reg),
+				    GC02M2_REG_OFFSET(reg));
+	}
+}
+
+/*
+ * What probe sets up, minus the clocks, regulators and GPIOs: the
+ * endpoint is taken as one lane at GC02M2_MIPI_LINK_FREQ and runtime PM
+ * only counts users, as there is no power to switch.
+ */
+static int gc02m2_test_init(struct kunit *test)
+{
+	struct i2c_board_info info = {
+		I2C_BOARD_INFO("gc02m2-kunit", GC02M2_FAKE_ADDR),
+	};
+	struct gc02m2_fake *fake;
+	struct gc02m2 *gc02m2;
+	int ret;
+
+	fake = kunit_kzalloc(test, sizeof(*fake), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, fake);
+	test->priv = fake;
+
+	fake->sys[GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_H) -
+		  GC02M2_SYS_REG_BASE] = CHIP_ID >> 8;
+	fake->sys[GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_L) -
+		  GC02M2_SYS_REG_BASE] = CHIP_ID & 0xff;
+
+	fake->adap.owner = THIS_MODULE;
+	fake->adap.algo = &gc02m2_fake_algo;
+	strscpy(fake->adap.name, "gc02m2 fake", sizeof(fake->adap.name));
+	i2c_set_adapdata(&fake->adap, fake);
+	ret = i2c_add_adapter(&fake->adap);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+	fake->adap_added = true;
+
+	fake->client = i2c_new_client_device(&fake->adap, &info);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fake->client);
+	pm_runtime_no_callbacks(&fake->client->dev);
+	pm_runtime_enable(&fake->client->dev);
+
+	gc02m2 = devm_kzalloc(&fake->client->dev, sizeof(*gc02m2),
+			      GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, gc02m2);
+
+	gc02m2->client = fake->client;
+	gc02m2->cur_mode = &supported_modes[0];
+	gc02m2->crop = gc02m2->cur_mode->crop;
+	gc02m2->cur_page = GC02M2_PAGE_UNKNOWN;
+	/* as probe leaves it without defer_chip_id */
+	gc02m2->chip_id_checked = true;
+	gc02m2->lane_num = 1;
+	gc02m2->link_cfgs[0] = gc02m2_find_pll_cfg(GC02M2_MIPI_LINK_FREQ);
+	gc02m2->link_freq_menu[0] = GC02M2_MIPI_LINK_FREQ;
+	gc02m2->nr_link_freqs = 1;
+	gc02m2_apply_link_cfg(gc02m2, gc02m2->link_cfgs[0]);
+
+	ret = gc02m2_init_subdev(gc02m2);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+	fake->gc02m2 = gc02m2;
+
+	return 0;
+}
+
+static void gc02m2_test_exit(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+
+	if (!fake)
+		return;
+
+	if (fake->gc02m2)
+		gc02m2_cleanup_subdev(fake->gc02m2);
+	if (!IS_ERR_OR_NULL(fake->client)) {
+		pm_runtime_disable(&fake->client->dev);
+		i2c_unregister_device(fake->client);
+	}
+	if (fake->adap_added)
+		i2c_del_adapter(&fake->adap);
+}
+
+static void gc02m2_test_chip_id(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+
+	KUNIT_EXPECT_EQ(test, gc02m2_check_sensor_id(gc02m2, fake->client), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2->chip_id, CHIP_ID);
+	KUNIT_EXPECT_TRUE(test, gc02m2->chip_id_checked);
+}
+
+static void gc02m2_test_wrong_chip_id(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+
+	gc02m2->chip_id_checked = false;
+	fake->sys[GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_L) -
+		  GC02M2_SYS_REG_BASE] = 0x00;
+
+	KUNIT_EXPECT_EQ(test, gc02m2_check_sensor_id(gc02m2, fake->client),
+			-ENODEV);
+	KUNIT_EXPECT_FALSE(test, gc02m2->chip_id_checked);
+}
+
+/* with defer_chip_id a missing sensor fails s_power, not every resume */
+static void gc02m2_test_deferred_chip_id(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	u8 *id_l = &fake->sys[GC02M2_REG_OFFSET(GC02M2_REG_CHIP_ID_L) -
+			      GC02M2_SYS_REG_BASE];
+	u8 saved = *id_l;
+
+	gc02m2->chip_id_checked = false;
+	*id_l = 0x00;
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 1), -ENODEV);
+	KUNIT_EXPECT_FALSE(test, gc02m2->power_on);
+
+	*id_l = saved;
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	KUNIT_EXPECT_TRUE(test, gc02m2->chip_id_checked);
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+/* the mirror/flip base is what the init sequence leaves in page 0 0x17 */
+static void gc02m2_test_flip_base(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	static const struct regval regs[] = {
+		{0xfe, 0x00},
+		{0x16, 0x11},
+		{0x17, 0x83},
+		{0x18, 0x22},
+		{0xfe, 0x04},
+		{0x17, 0x55},
+		{REG_NULL, 0x00},
+	};
+	struct gc02m2_reg_seq seq;
+	const u8 *val;
+
+	KUNIT_EXPECT_EQ(test, fake->gc02m2->flip_base, 0x80);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_compile_regs(&fake->client->dev, regs,
+						  &seq), 0);
+	val = gc02m2_seq_find_paged(&seq, GC02M2_MIRROR_FLIP_REG);
+	KUNIT_ASSERT_NOT_NULL(test, val);
+	KUNIT_EXPECT_EQ(test, *val, 0x83);
+	KUNIT_EXPECT_NULL(test, gc02m2_seq_find_paged(&seq,
+						      GC02M2_REG(1, 0x17)));
+}
+
+/* a page is only selected when the sensor is not on it already */
+static void gc02m2_test_page_select(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(1, 0x10),
+					       0x55), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 2);
+	KUNIT_EXPECT_EQ(test, fake->page, 1);
+	KUNIT_EXPECT_EQ(test, fake->regs[1][0x10], 0x55);
+
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(1, 0x11),
+					       0x66), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 1);
+
+	/* the system block is reached from any page */
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(0, 0xfc),
+					       0x01), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 1);
+	KUNIT_EXPECT_EQ(test, fake->page, 1);
+
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(0, 0x10),
+					       0x77), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 2);
+	KUNIT_EXPECT_EQ(test, fake->regs[0][0x10], 0x77);
+	KUNIT_EXPECT_EQ(test, fake->regs[1][0x10], 0x55);
+}
+
+static void gc02m2_test_cache(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(2, 0x20),
+					       0x12), 0);
+
+	/* the sensor holds the value already */
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(2, 0x20),
+					       0x12), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 0);
+
+	/* a lost register file is rewritten by a sync */
+	memset(fake->regs, 0, sizeof(fake->regs));
+	gc02m2_regcache_mark_dirty(gc02m2);
+	KUNIT_ASSERT_EQ(test, gc02m2_regcache_sync(gc02m2), 0);
+	KUNIT_EXPECT_EQ(test, fake->regs[2][0x20], 0x12);
+	gc02m2_expect_cache_matches(test, fake);
+}
+
+/* after a failed transfer the page select may not have landed */
+static void gc02m2_test_failed_xfer(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(3, 0x30),
+					       0x01), 0);
+
+	fake->fail = true;
+	KUNIT_EXPECT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(3, 0x31),
+					       0x02), -EIO);
+	KUNIT_EXPECT_EQ(test, gc02m2->cur_page, GC02M2_PAGE_UNKNOWN);
+
+	fake->page = 0;
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_write_reg(gc02m2, GC02M2_REG(3, 0x31),
+					       0x02), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 2);
+	KUNIT_EXPECT_EQ(test, fake->regs[3][0x31], 0x02);
+}
+
+static void gc02m2_test_stream(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	const struct gc02m2_mode *mode = gc02m2->cur_mode;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_REG_PLL),
+			gc02m2->link_cfgs[0]->pll);
+	gc02m2_expect_cache_matches(test, fake);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 1), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_MODE_SELECT),
+			GC02M2_MODE_STREAMING);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_REG_VTS_H),
+			mode->vts_def >> 8);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_REG_VTS_L),
+			mode->vts_def & 0xff);
+	KUNIT_EXPECT_EQ(test,
+			gc02m2_fake_read_reg(fake, GC02M2_MIRROR_FLIP_REG),
+			gc02m2->flip_base);
+	gc02m2_expect_cache_matches(test, fake);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 0), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_MODE_SELECT),
+			GC02M2_MODE_SW_STANDBY);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+/* crops go anywhere in CROP_BOUNDS, reading out the mode holding them */
+static void gc02m2_test_crop_bounds(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	const struct gc02m2_mode *full = &supported_modes[1];
+	struct v4l2_subdev_selection sel = {
+		.which = V4L2_SUBDEV_FORMAT_ACTIVE,
+		.target = V4L2_SEL_TGT_CROP_BOUNDS,
+	};
+
+	KUNIT_ASSERT_EQ(test, gc02m2_get_selection(sd, NULL, &sel), 0);
+	KUNIT_EXPECT_EQ(test, sel.r.width, full->crop.width);
+	KUNIT_EXPECT_EQ(test, sel.r.height, full->crop.height);
+
+	/* past the default mode's window */
+	sel.target = V4L2_SEL_TGT_CROP;
+	sel.r.left = 32;
+	sel.r.top = 32;
+	sel.r.width = full->crop.width - 64;
+	sel.r.height = full->crop.height - 64;
+	KUNIT_ASSERT_EQ(test, gc02m2_set_selection(sd, NULL, &sel), 0);
+	KUNIT_EXPECT_EQ(test, sel.r.width, full->crop.width - 64);
+	KUNIT_EXPECT_EQ(test, sel.r.height, full->crop.height - 64);
+	KUNIT_EXPECT_PTR_EQ(test, gc02m2->cur_mode, full);
+	KUNIT_EXPECT_EQ(test, gc02m2->vblank->val,
+			full->vts_def - sel.r.height);
+}
+
+/* DIGITAL_GAIN is part of the exposure cluster and scales the pregain */
+static void gc02m2_test_digital_gain(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	const struct gc02m2_gain *gain;
+	u32 dgain = 2 * DIGITAL_GAIN_BASE;
+	u32 pregain;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	gc02m2_fake_reset_counts(fake);
+
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->digi_gain, dgain), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 1);
+
+	gain = &gc02m2->gain_lut[gc02m2->anal_gain->val - GC02M2_GAIN_MIN];
+	pregain = min_t(u32, gain->pregain * dgain / DIGITAL_GAIN_BASE,
+			GC02M2_PREGAIN_MAX);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_PREGAIN_H_REG),
+			pregain >> 8);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_PREGAIN_L_REG),
+			pregain & 0xff);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+/*
+ * VIDIOC_G_EXT_CTRLS, as libcamera reads the cluster, and the applied
+ * gain after an analogue gain write.
+ */
+static void gc02m2_test_read_controls(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	u32 again = GC02M2_GAIN_DEFAULT + 0x40;
+	struct v4l2_ext_control ctrls[] = {
+		{ .id = V4L2_CID_EXPOSURE },
+		{ .id = V4L2_CID_ANALOGUE_GAIN },
+		{ .id = V4L2_CID_VBLANK },
+		{ .id = V4L2_CID_GC02M2_ANALOGUE_GAIN_APPLIED },
+	};
+	struct v4l2_ext_controls cs = {
+		.which = V4L2_CTRL_WHICH_CUR_VAL,
+		.count = ARRAY_SIZE(ctrls),
+		.controls = ctrls,
+	};
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->anal_gain, again), 0);
+
+	KUNIT_ASSERT_EQ(test, v4l2_g_ext_ctrls(&gc02m2->ctrl_handler, NULL,
+					       NULL, &cs), 0);
+	KUNIT_EXPECT_EQ(test, ctrls[0].value, gc02m2->exposure->cur.val);
+	KUNIT_EXPECT_EQ(test, ctrls[1].value, again);
+	KUNIT_EXPECT_EQ(test, ctrls[2].value, gc02m2->vblank->cur.val);
+	KUNIT_EXPECT_EQ(test, ctrls[3].value,
+			gc02m2->gain_lut[again - GC02M2_GAIN_MIN].applied);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+/* the control reports the exposure as fitted to the frame */
+static void gc02m2_test_exposure_fit(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	u32 vts = gc02m2->crop.height + gc02m2->vblank->val;
+
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->exposure,
+					       gc02m2->exposure->maximum), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2->exposure->val,
+			vts - GC02M2_EXPOSURE_MARGIN);
+	KUNIT_EXPECT_EQ(test, v4l2_ctrl_g_ctrl(gc02m2->exposure),
+			vts - GC02M2_EXPOSURE_MARGIN);
+}
+
+enum gc02m2_test_op {
+	GC02M2_TEST_PROBE,
+	GC02M2_TEST_S_POWER,
+	GC02M2_TEST_STREAM_ON,
+	GC02M2_TEST_STREAM_ON_COLD,
+	GC02M2_TEST_STREAM_OFF,
+	GC02M2_TEST_SET_CTRL,
+	GC02M2_TEST_SET_FMT,
+	GC02M2_TEST_MODE_SWITCH,
+	GC02M2_TEST_NUM_OPS,
+};
+
+struct gc02m2_budget {
+	const char *name;
+	unsigned int xfers;
+	unsigned int bytes;
+};
+
+/*
+ * Transfers and bytes per call, register addresses included. Powering
+ * on writes the init table (101 bursts, 289 bytes) and the mode window;
+ * stream on and a control are one batched transfer; set_fmt while
+ * powered rewrites VTS through the exposure cluster; a mode switch adds
+ * the window and its page select to the next stream on.
+ */
+static const struct gc02m2_budget gc02m2_budgets[GC02M2_TEST_NUM_OPS] = {
+	[GC02M2_TEST_PROBE]		= { "probe", 2, 4 },
+	[GC02M2_TEST_S_POWER]		= { "s_power", 102, 299 },
+	[GC02M2_TEST_STREAM_ON]		= { "stream_on", 1,
+					    GC02M2_XFER_BUF_SIZE },
+	[GC02M2_TEST_STREAM_ON_COLD]	= { "stream_on_cold", 103,
+					    299 + GC02M2_XFER_BUF_SIZE },
+	[GC02M2_TEST_STREAM_OFF]	= { "stream_off", 2, 4 },
+	[GC02M2_TEST_SET_CTRL]		= { "set_ctrl", 1,
+					    GC02M2_XFER_BUF_SIZE },
+	[GC02M2_TEST_SET_FMT]		= { "set_fmt", 1,
+					    GC02M2_XFER_BUF_SIZE },
+	[GC02M2_TEST_MODE_SWITCH]	= { "mode_switch", 3,
+					    12 + GC02M2_XFER_BUF_SIZE },
+};
+
+/*
+ * Report the traffic since the last reset and fail the test if it is
+ * over budget. A message costs START, address, a byte per 9 clocks and
+ * STOP; the estimates are at 100 kHz, 400 kHz and 1 MHz.
+ */
+static void gc02m2_check_budget(struct kunit *test, enum gc02m2_test_op op)
+{
+	struct gc02m2_fake *fake = test->priv;
+	const struct gc02m2_budget *budget = &gc02m2_budgets[op];
+	unsigned int bits = fake->bytes * 9 + fake->msgs * (9 + 2);
+
+	kunit_info(test, "%s: %u transfers, %u messages, %u bytes, est %u/%u/%u us\n",
+		   budget->name, fake->xfers, fake->msgs, fake->bytes,
+		   bits * 10, DIV_ROUND_UP(bits * 10, 4), bits);
+
+	KUNIT_ASSERT_LE_MSG(test, fake->xfers, budget->xfers,
+			    "%s over its transfer budget", budget->name);
+	KUNIT_ASSERT_LE_MSG(test, fake->bytes, budget->bytes,
+			    "%s over its byte budget", budget->name);
+
+	gc02m2_fake_reset_counts(fake);
+}
+
+/* setting up the subdev is bus free, probe only reads the chip ID */
+static void gc02m2_test_budget_probe(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_check_sensor_id(fake->gc02m2,
+						     fake->client), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_PROBE);
+}
+
+static void gc02m2_test_budget_stream(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_S_POWER);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_STREAM_ON);
+
+	/* a per-frame AE update */
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->exposure,
+					       gc02m2->exposure->val / 2), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_SET_CTRL);
+
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->anal_gain,
+					       gc02m2->anal_gain->val + 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_SET_CTRL);
+
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->vblank,
+					       gc02m2->vblank->val + 100), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_SET_CTRL);
+
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->hflip, 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_SET_CTRL);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 0), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_STREAM_OFF);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+/* stream on without s_power loads the init table itself */
+static void gc02m2_test_budget_stream_cold(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct v4l2_subdev *sd = &fake->gc02m2->subdev;
+
+	gc02m2_fake_reset_counts(fake);
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_STREAM_ON_COLD);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_stream(sd, 0), 0);
+}
+
+/*
+ * While powered, the VBLANK reset in set_fmt writes the exposure
+ * cluster; the new mode's registers follow at the next stream on.
+ */
+static void gc02m2_test_budget_set_fmt(struct kunit *test)
+{
+	struct gc02m2_fake *fake = test->priv;
+	struct gc02m2 *gc02m2 = fake->gc02m2;
+	struct v4l2_subdev *sd = &gc02m2->subdev;
+	const struct gc02m2_mode *mode = &supported_modes[1];
+	struct v4l2_subdev_format fmt = {
+		.which = V4L2_SUBDEV_FORMAT_ACTIVE,
+		.format = {
+			.width = mode->width,
+			.height = mode->height,
+			.code = mode->bus_fmt,
+		},
+	};
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_power(sd, 1), 0);
+	KUNIT_ASSERT_EQ(test, v4l2_ctrl_s_ctrl(gc02m2->vblank,
+					       gc02m2->vblank->val + 100), 0);
+	gc02m2_fake_reset_counts(fake);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_set_fmt(sd, NULL, &fmt), 0);
+	KUNIT_EXPECT_EQ(test, fake->xfers, 1);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_REG_VTS_H),
+			mode->vts_def >> 8);
+	KUNIT_EXPECT_EQ(test, gc02m2_fake_read_reg(fake, GC02M2_REG_VTS_L),
+			mode->vts_def & 0xff);
+	gc02m2_check_budget(test, GC02M2_TEST_SET_FMT);
+
+	KUNIT_ASSERT_EQ(test, gc02m2_s_stream(sd, 1), 0);
+	gc02m2_check_budget(test, GC02M2_TEST_MODE_SWITCH);
+	gc02m2_expect_cache_matches(test, fake);
+	/* the active format is frozen while streaming */
+	KUNIT_EXPECT_EQ(test, gc02m2_set_fmt(sd, NULL, &fmt), -EBUSY);
+
+	KUNIT_EXPECT_EQ(test, gc02m2_s_stream(sd, 0), 0);
+	KUNIT_EXPECT_EQ(test, gc02m2_s_power(sd, 0), 0);
+}
+
+static struct kunit_case gc02m2_test_cases[] = {
+	KUNIT_CASE(gc02m2_test_chip_id),
+	KUNIT_CASE(gc02m2_test_wrong_chip_id),
+	KUNIT_CASE(gc02m2_test_deferred_chip_id),
+	KUNIT_CASE(gc02m2_test_flip_base),
+	KUNIT_CASE(gc02m2_test_page_select),
+	KUNIT_CASE(gc02m2_test_cache),
+	KUNIT_CASE(gc02m2_test_failed_xfer),
+	KUNIT_CASE(gc02m2_test_stream),
+	KUNIT_CASE(gc02m2_test_crop_bounds),
+	KUNIT_CASE(gc02m2_test_digital_gain),
+	KUNIT_CASE(gc02m2_test_read_controls),
+	KUNIT_CASE(gc02m2_test_exposure_fit),
+	KUNIT_CASE(gc02m2_test_budget_probe),
+	KUNIT_CASE(gc02m2_test_budget_stream),
+	KUNIT_CASE(gc02m2_test_budget_stream_cold),
+	KUNIT_CASE(gc02m2_test_budget_set_fmt),
+	{}
+};
+
+static struct kunit_suite gc02m2_test_suite = {
+	.name = "gc02m2",
+	.init = gc02m2_test_init,
+	.exit = gc02m2_test_exit,
+	.test_cases = gc02m2_test_cases,
+};
+
+kunit_test_suites(&gc02m2_test_suite);
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * gc02m2 trace events
+ *
+ * Register I/O, power transitions and stream start latency, for
+ * profiling camera start-up with ftrace or perf.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gc02m2
+
+#if !defined(_GC02M2_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GC02M2_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+/*
+ * One i2c_transfer(). page is the page selected before the transfer
+ * (-1 if unknown), reg the first register addressed and len the bytes
+ * of all messages.
+ */
+TRACE_EVENT(gc02m2_i2c_xfer,
+	TP_PROTO(struct device *dev, int page, u8 reg, unsigned int num_msgs,
+		 unsigned int len, s64 duration_ns, int err),
+	TP_ARGS(dev, page, reg, num_msgs, len, duration_ns, err),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(int, page)
+		__field(u8, reg)
+		__field(unsigned int, num_msgs)
+		__field(unsigned int, len)
+		__field(s64, duration_ns)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->page = page;
+		__entry->reg = reg;
+		__entry->num_msgs = num_msgs;
+		__entry->len = len;
+		__entry->duration_ns = duration_ns;
+		__entry->err = err;
+	),
+	TP_printk("%s page=%d reg=0x%02x msgs=%u len=%u duration=%lldns err=%d",
+		  __get_str(name), __entry->page, __entry->reg,
+		  __entry->num_msgs, __entry->len, __entry->duration_ns,
+		  __entry->err)
+);
+
+TRACE_EVENT(gc02m2_power,
+	TP_PROTO(struct device *dev, bool on, s64 duration_ns, int err),
+	TP_ARGS(dev, on, duration_ns, err),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(bool, on)
+		__field(s64, duration_ns)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->on = on;
+		__entry->duration_ns = duration_ns;
+		__entry->err = err;
+	),
+	TP_printk("%s %s duration=%lldns err=%d",
+		  __get_str(name), __entry->on ? "on" : "off",
+		  __entry->duration_ns, __entry->err)
+);
+
+/*
+ * s_stream from entry to return. first_write_ns is the time until the
+ * first register transfer, -1 if there was none.
+ */
+TRACE_EVENT(gc02m2_s_stream,
+	TP_PROTO(struct device *dev, bool on, s64 duration_ns,
+		 s64 first_write_ns, int err),
+	TP_ARGS(dev, on, duration_ns, first_write_ns, err),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(bool, on)
+		__field(s64, duration_ns)
+		__field(s64, first_write_ns)
+		__field(int, err)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->on = on;
+		__entry->duration_ns = duration_ns;
+		__entry->first_write_ns = first_write_ns;
+		__entry->err = err;
+	),
+	TP_printk("%s %s duration=%lldns first_write=%lldns err=%d",
+		  __get_str(name), __entry->on ? "on" : "off",
+		  __entry->duration_ns, __entry->first_write_ns,
+		  __entry->err)
+);
+
+#endif /* _GC02M2_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gc02m2_trace
+#include <trace/define_trace.h>
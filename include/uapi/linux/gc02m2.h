@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * GalaxyCore GC02M2 sensor driver controls
+ */
+
+#ifndef __UAPI_GC02M2_H__
+#define __UAPI_GC02M2_H__
+
+#include <linux/types.h>
+#include <linux/v4l2-controls.h>
+#include <linux/videodev2.h>
+
+/*
+ * 16 controls, well above the driver ranges mainline hands out from
+ * 0x1000 on (0x11c0 is THP7312's since v6.8). Kernels patched with
+ * patches/0001-media-v4l2-controls-Reserve-controls-for-gc02m2.patch
+ * define the same base; unpatched ones build with this one.
+ */
+#ifndef V4L2_CID_USER_GC02M2_BASE
+#define V4L2_CID_USER_GC02M2_BASE		(V4L2_CID_USER_BASE + 0x1f00)
+#endif
+
+/*
+ * Read only, pairs of { control id, frames until it takes effect }.
+ * The delays have not been measured on a sensor yet.
+ */
+#define V4L2_CID_GC02M2_CTRL_DELAYS		(V4L2_CID_USER_GC02M2_BASE + 1)
+
+/*
+ * Read only, the analogue gain code the sensor really applies. Not every
+ * V4L2_CID_ANALOGUE_GAIN code splits exactly into an analogue step and
+ * a pregain; this reports what the last programmed pair produces.
+ */
+#define V4L2_CID_GC02M2_ANALOGUE_GAIN_APPLIED	(V4L2_CID_USER_GC02M2_BASE + 2)
+
+/* carries a struct gc02m2_status, sent with the status_readback parameter */
+#define GC02M2_EVENT_STATUS			(V4L2_EVENT_PRIVATE_START + 1)
+
+/*
+ * Payload of GC02M2_EVENT_STATUS in v4l2_event.u.data: the exposure
+ * registers as latched in the sensor and its mode register (0x3e),
+ * which drops out of streaming (0x90) if the sensor stopped on its own.
+ */
+struct gc02m2_status {
+	__u64 timestamp_ns;	/* CLOCK_MONOTONIC, after the read */
+	__u32 sequence;		/* samples since stream on */
+	__u16 exposure;
+	__u16 vts;
+	__u16 pregain;
+	__u8 again;
+	__u8 mode_select;
+};
+
+#endif /* __UAPI_GC02M2_H__ */